@@ -1,17 +1,35 @@
 """nubivis setup"""
-from setuptools import setup, find_packages
+from setuptools import setup, find_packages, Extension
 
 version = "0.0.1"
-extra_compile_args = ["-O3", "-w"]
-# extensions = [
-#     Extension(
-#         name="nubivis.parser",
-#         sources=["source/parser.cpp"],
-#         include_dirs=["source"],
-#         extra_compile_args=extra_compile_args,
-#         language="c++",
-#     )
-# ]
+extra_compile_args = ["-O3", "-w", "-std=c++23", "-pthread"]
+extensions = [
+    Extension(
+        name="nubivis.parser",
+        sources=[
+            "source/parsermodule.cpp",
+            "source/stats.cpp",
+            "source/arena.cpp",
+            "source/rational.cpp",
+            "source/parser.cpp",
+            "source/fastfactors.cpp",
+            "source/threadpool.cpp",
+            "source/convert.cpp",
+            "source/reverse.cpp",
+            "source/registry.cpp",
+            "source/trie.cpp",
+            "source/serialize.cpp",
+            "source/dimensions.cpp",
+            "source/canonical.cpp",
+            "source/lazy.cpp",
+            "source/units.cpp",
+        ],
+        include_dirs=["source"],
+        extra_compile_args=extra_compile_args,
+        extra_link_args=["-pthread"],
+        language="c++",
+    )
+]
 kwargs = {
     "name": "nubivis",
     "description": "Compute everywhere with units",
@@ -19,9 +37,9 @@ kwargs = {
     "author_email": "lee.johnston.100@gmail.com",
     "version": version,
     "package_dir": {"": "source"},
-    "packages": find_packages(),
-    "install_requires": ["numpy"]
-    # "ext_modules": extensions,
+    "packages": find_packages("source"),
+    "install_requires": ["numpy"],
+    "ext_modules": extensions,
 }
 if __name__ == "__main__":
     setup(**kwargs)
@@ -0,0 +1,51 @@
+#include "arena.h"
+#include "stats.h"
+
+const size_t HEADER{alignof(std::max_align_t)};
+const unsigned char FROMHEAP{0};
+const unsigned char FROMARENA{1};
+
+thread_local ParseSession *current{nullptr};
+
+ParseSession::ParseSession() : previous{current}, active{true}
+{
+    current = this;
+}
+
+ParseSession::~ParseSession()
+{
+    end();
+}
+
+void ParseSession::end()
+{
+    if (!active)
+        return;
+    active = false;
+    current = previous;
+}
+
+void *ParseSession::allocate(size_t bytes)
+{
+    std::byte *p{};
+    if (current != nullptr)
+    {
+        NUBIVIS_COUNT(arena_allocations);
+        p = static_cast<std::byte *>(current->arena.allocate(bytes + HEADER, HEADER));
+        *reinterpret_cast<unsigned char *>(p) = FROMARENA;
+    }
+    else
+    {
+        NUBIVIS_COUNT(heap_allocations);
+        p = static_cast<std::byte *>(::operator new(bytes + HEADER));
+        *reinterpret_cast<unsigned char *>(p) = FROMHEAP;
+    }
+    return p + HEADER;
+}
+
+void ParseSession::deallocate(void *block)
+{
+    std::byte *p{static_cast<std::byte *>(block) - HEADER};
+    if (*reinterpret_cast<unsigned char *>(p) == FROMHEAP)
+        ::operator delete(p);
+}
@@ -0,0 +1,45 @@
+#ifndef ARENA_H
+#define ARENA_H
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+
+// Allocations made while a ParseSession is active on the calling thread come
+// from its monotonic arena and are released together when the session ends.
+// Each block carries a one-word header naming its origin so deallocate can
+// tell arena blocks (a no-op) from heap blocks.
+class ParseSession
+{
+private:
+    alignas(std::max_align_t) std::byte initial[4096];
+    std::pmr::monotonic_buffer_resource arena{initial, sizeof(initial)};
+    ParseSession *previous{nullptr};
+    bool active{false};
+
+public:
+    ParseSession();
+    ParseSession(const ParseSession &) = delete;
+    ParseSession &operator=(const ParseSession &) = delete;
+    ~ParseSession();
+    void end();
+    static void *allocate(size_t);
+    static void deallocate(void *);
+};
+
+template <typename T>
+class SessionAllocator
+{
+public:
+    typedef T value_type;
+
+    SessionAllocator() = default;
+    template <typename U>
+    SessionAllocator(const SessionAllocator<U> &) {}
+    T *allocate(size_t n) { return static_cast<T *>(ParseSession::allocate(n * sizeof(T))); }
+    void deallocate(T *p, size_t) { ParseSession::deallocate(p); }
+    template <typename U>
+    bool operator==(const SessionAllocator<U> &) const { return true; }
+    template <typename U>
+    bool operator!=(const SessionAllocator<U> &) const { return false; }
+};
+#endif // ARENA_H
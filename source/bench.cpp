@@ -0,0 +1,275 @@
+#include <benchmark/benchmark.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "canonical.h"
+#include "convert.h"
+#include "dimensions.h"
+#include "lazy.h"
+#include "parser.h"
+
+const std::vector<std::string_view> SIMPLE{"m", "s", "kg", "N", "Pa", "ft", "degF", "h"};
+const std::vector<std::string_view> PREFIXED{"km", "mm", "µs", "MHz", "kPa", "dam", "GW", "nA"};
+const std::vector<std::string_view> NESTED{"kg*m/(s**2*(A*(K/mol)))", "(m/(s*(s/(m*(kg)))))", "N*m/((s)*(A*(cd)))", "(((m)))/(((s)))"};
+const std::vector<std::string_view> FRACTIONAL{"m**(1/2)", "km**(3/2)", "s**(-1/3)", "cm**(2/3)/s**(1/2)", "Hz**(1/2)", "(m/s)**(5/4)"};
+
+void parse_corpus(benchmark::State &state, const std::vector<std::string_view> &corpus)
+{
+    size_t i{0};
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(Parser::try_parse_uncached(corpus[i]));
+        i = i + 1 == corpus.size() ? 0 : i + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_ParseSimple(benchmark::State &state) { parse_corpus(state, SIMPLE); }
+void BM_ParsePrefixed(benchmark::State &state) { parse_corpus(state, PREFIXED); }
+void BM_ParseNested(benchmark::State &state) { parse_corpus(state, NESTED); }
+void BM_ParseFractional(benchmark::State &state) { parse_corpus(state, FRACTIONAL); }
+
+void dimension_corpus(benchmark::State &state, const std::vector<std::string_view> &corpus)
+{
+    size_t i{0};
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(try_parse_dimensions(corpus[i]));
+        i = i + 1 == corpus.size() ? 0 : i + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_DimensionsNested(benchmark::State &state) { dimension_corpus(state, NESTED); }
+void BM_DimensionsFractional(benchmark::State &state) { dimension_corpus(state, FRACTIONAL); }
+
+// Worst cases within the input limits: the deepest nesting accepted, the
+// longest expression accepted, a letter token at the length limit, and
+// inputs rejected for depth or length, which should cost no more than
+// reading them.
+void parse_worst(benchmark::State &state, const std::string &units)
+{
+    for (auto _ : state)
+        benchmark::DoNotOptimize(Parser::try_parse_uncached(units));
+    state.SetBytesProcessed(state.iterations() * units.size());
+}
+
+void BM_WorstNested(benchmark::State &state)
+{
+    parse_worst(state, std::string(DEPTHMAX - 1, '(') + "m" + std::string(DEPTHMAX - 1, ')'));
+}
+
+void BM_WorstUnary(benchmark::State &state)
+{
+    parse_worst(state, "m**" + std::string(DEPTHMAX - 2, '-') + "1");
+}
+
+void BM_WorstLong(benchmark::State &state)
+{
+    std::string units{"kmol"};
+    while (units.size() + 5 <= LENMAXEXPRESSION)
+        units += "/kmol";
+    parse_worst(state, units);
+}
+
+void BM_WorstPowers(benchmark::State &state)
+{
+    std::string units{"ft**99"};
+    while (units.size() + 9 <= LENMAXEXPRESSION)
+        units += "*ft**99";
+    parse_worst(state, units + "*m");
+}
+
+void BM_WorstLongToken(benchmark::State &state)
+{
+    parse_worst(state, "m*" + std::string(128, 'm'));
+}
+
+void BM_RejectTooDeep(benchmark::State &state)
+{
+    parse_worst(state, std::string(LENMAXEXPRESSION / 2, '(') + "m" + std::string(LENMAXEXPRESSION / 2 - 1, ')'));
+}
+
+void BM_RejectTooLong(benchmark::State &state)
+{
+    parse_worst(state, std::string(size_t{1} << 20, 'm'));
+}
+
+void BM_CacheHit(benchmark::State &state)
+{
+    Parser p{};
+    p.parse("kg*m/s**2");
+    for (auto _ : state)
+        benchmark::DoNotOptimize(p.try_parse("kg*m/s**2"));
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Alternating two expressions through a one-entry cache misses every time.
+void BM_CacheMiss(benchmark::State &state)
+{
+    Parser p{1};
+    bool odd{false};
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(p.try_parse(odd ? "kg*m/s**2" : "km/h"));
+        odd = !odd;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_FactorsMultiply(benchmark::State &state)
+{
+    Factors a{Parser::parse_uncached("km/h")};
+    Factors b{Parser::parse_uncached("N*s")};
+    for (auto _ : state)
+        benchmark::DoNotOptimize(a * b);
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_FactorsDivide(benchmark::State &state)
+{
+    Factors a{Parser::parse_uncached("km/h")};
+    Factors b{Parser::parse_uncached("N*s")};
+    for (auto _ : state)
+        benchmark::DoNotOptimize(a / b);
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_FactorsPow(benchmark::State &state)
+{
+    Factors a{Parser::parse_uncached("cm")};
+    Factors e{Parser::parse_uncached("m**(3/2)").get_dimension()[0], 0, 0, 0, 0, 0, 0, 0, 0};
+    for (auto _ : state)
+    {
+        Factors f{a};
+        benchmark::DoNotOptimize(f.try_pow(e));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_FactorsEqual(benchmark::State &state)
+{
+    Factors a{Parser::parse_uncached("m/s")};
+    Factors b{Parser::parse_uncached("(m)/(s)")};
+    for (auto _ : state)
+        benchmark::DoNotOptimize(a == b);
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_UnitIdEqual(benchmark::State &state)
+{
+    UnitInterner interner{};
+    UnitId a{interner.intern(Parser::parse_uncached("m/s"))};
+    UnitId b{interner.intern(Parser::parse_uncached("(m)/(s)"))};
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(a);
+        benchmark::DoNotOptimize(a == b);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_Intern(benchmark::State &state)
+{
+    UnitInterner interner{};
+    Factors a{Parser::parse_uncached("kg*m/s**2")};
+    for (auto _ : state)
+        benchmark::DoNotOptimize(interner.intern(a));
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Bytes processed counts the read and the write, so the reported rate is
+// memory traffic.
+template <typename T>
+void BM_Convert(benchmark::State &state)
+{
+    ConversionPlan plan{Parser::parse_uncached("ft"), Parser::parse_uncached("m")};
+    std::vector<T> in(state.range(0), T{1});
+    std::vector<T> out(state.range(0));
+    for (auto _ : state)
+    {
+        plan.apply(in, out);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * sizeof(T) * 2);
+}
+
+template <typename T>
+void BM_ConvertParallel(benchmark::State &state)
+{
+    ConversionPlan plan{Parser::parse_uncached("ft"), Parser::parse_uncached("m")};
+    std::vector<T> in(state.range(0), T{1});
+    std::vector<T> out(state.range(0));
+    for (auto _ : state)
+    {
+        plan.apply(in, out, ThreadPool::shared());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * sizeof(T) * 2);
+}
+
+// a[mm] + b[in] * c in metres: converting each input separately and then
+// combining, against one fused pass. Bytes processed counts three reads and
+// a write either way.
+void BM_ChainEager(benchmark::State &state)
+{
+    Factors mm{Parser::parse_uncached("mm")};
+    Factors in{Parser::parse_uncached("in")};
+    Factors m{Parser::parse_uncached("m")};
+    std::vector<double> a(state.range(0), 1), b(state.range(0), 1), c(state.range(0), 2);
+    std::vector<double> x(state.range(0)), y(state.range(0));
+    for (auto _ : state)
+    {
+        ConversionPlan(mm, m).apply(a, x);
+        ConversionPlan(in, m).apply(b, y);
+        for (size_t i = 0; i < x.size(); i++)
+            x[i] += y[i] * c[i];
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * sizeof(double) * 4);
+}
+
+void BM_ChainFused(benchmark::State &state)
+{
+    Factors mm{Parser::parse_uncached("mm")};
+    Factors in{Parser::parse_uncached("in")};
+    Factors m{Parser::parse_uncached("m")};
+    std::vector<double> a(state.range(0), 1), b(state.range(0), 1), c(state.range(0), 2);
+    std::vector<double> x(state.range(0));
+    Expression<double> e{Expression<double>(a, mm) + Expression<double>(b, in) * Expression<double>(c, Factors{})};
+    for (auto _ : state)
+    {
+        e.evaluate(x, m);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * sizeof(double) * 4);
+}
+
+BENCHMARK(BM_ParseSimple);
+BENCHMARK(BM_ParsePrefixed);
+BENCHMARK(BM_ParseNested);
+BENCHMARK(BM_ParseFractional);
+BENCHMARK(BM_DimensionsNested);
+BENCHMARK(BM_DimensionsFractional);
+BENCHMARK(BM_WorstNested);
+BENCHMARK(BM_WorstUnary);
+BENCHMARK(BM_WorstLong);
+BENCHMARK(BM_WorstPowers);
+BENCHMARK(BM_WorstLongToken);
+BENCHMARK(BM_RejectTooDeep);
+BENCHMARK(BM_RejectTooLong);
+BENCHMARK(BM_CacheHit);
+BENCHMARK(BM_CacheMiss);
+BENCHMARK(BM_FactorsMultiply);
+BENCHMARK(BM_FactorsDivide);
+BENCHMARK(BM_FactorsPow);
+BENCHMARK(BM_FactorsEqual);
+BENCHMARK(BM_UnitIdEqual);
+BENCHMARK(BM_Intern);
+BENCHMARK(BM_Convert<float>)->Range(1 << 10, 1 << 24);
+BENCHMARK(BM_Convert<double>)->Range(1 << 10, 1 << 24);
+BENCHMARK(BM_ConvertParallel<float>)->Range(1 << 20, 1 << 24)->UseRealTime();
+BENCHMARK(BM_ConvertParallel<double>)->Range(1 << 20, 1 << 24)->UseRealTime();
+BENCHMARK(BM_ChainEager)->Range(1 << 10, 1 << 24);
+BENCHMARK(BM_ChainFused)->Range(1 << 10, 1 << 24);
+BENCHMARK_MAIN();
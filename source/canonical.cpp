@@ -0,0 +1,150 @@
+#include <array>
+#include <functional>
+#include <string_view>
+#include "canonical.h"
+
+const std::array<std::string_view, 7> BASEUNITS{"m", "kg", "s", "A", "K", "mol", "cd"};
+
+void append_term(std::string &out, std::string_view unit, const Fraction &e)
+{
+    if (!out.empty())
+        out.append("*");
+    out.append(unit);
+    if (e == 1)
+        return;
+    out.append("**");
+    if (e.is_integer())
+        out.append(e.str());
+    else
+        out.append("(" + e.str() + ")");
+}
+
+std::string canonical_key(const Factors &f)
+{
+    std::array<Fraction, 7> d{f.get_dimension()};
+    std::string above{};
+    std::string below{};
+    size_t terms{0};
+    for (size_t i = 0; i < d.size(); i++)
+    {
+        if (d[i] > 0)
+            append_term(above, BASEUNITS[i], d[i]);
+        else if (d[i] < 0)
+        {
+            append_term(below, BASEUNITS[i], -d[i]);
+            terms++;
+        }
+    }
+    std::string out{};
+    Fraction x{f.get_multiplier()};
+    if (f.get_degree() > 1)
+    {
+        out = (x < 0 ? "-(" : "(") + f.get_radicand().str() + ")**(1/" + std::to_string(f.get_degree()) + ")";
+        if (!above.empty())
+            out.append("*");
+    }
+    else if (x != 1 || f.get_degree() == 0)
+    {
+        out = x.is_integer() && x > 0 ? x.str() : "(" + x.str() + ")";
+        if (f.get_degree() == 0)
+            out.insert(0, "~");
+        if (!above.empty())
+            out.append("*");
+    }
+    out.append(above);
+    if (out.empty())
+        out = "1";
+    if (terms == 1)
+        out.append("/" + below);
+    else if (terms > 1)
+        out.append("/(" + below + ")");
+    if (f.has_offset())
+        out.append("+" + f.get_offset().str());
+    return out;
+}
+
+// A value has a single representation, so small parts hash as integers
+// and only big ones go through their decimal string.
+void hash_combine(size_t &h, size_t x)
+{
+    h ^= x + 0x9e3779b97f4a7c15 + (h << 6) + (h >> 2);
+}
+
+void hash_fraction(size_t &h, const Fraction &x)
+{
+    if (x.is_big())
+        return hash_combine(h, std::hash<std::string>{}(x.str()));
+    hash_combine(h, std::hash<int64_t>{}(x.get_numerator()));
+    hash_combine(h, std::hash<int64_t>{}(x.get_denominator()));
+}
+
+// Equal Factors have equal signatures unless the dimension is inexact, in
+// which case the exponents themselves are hashed.
+size_t FactorsHash::operator()(const Factors &f) const
+{
+    size_t h{f.get_degree()};
+    if (f.get_degree() > 1)
+    {
+        hash_fraction(h, f.get_radicand());
+        hash_combine(h, f.get_multiplier() < 0);
+    }
+    else
+        hash_fraction(h, f.get_multiplier());
+    hash_fraction(h, f.get_offset());
+    if (f.get_signature() != SIGNATUREINEXACT)
+        hash_combine(h, std::hash<uint64_t>{}(f.get_signature()));
+    else
+        for (const Fraction &e : f.get_dimension())
+            hash_fraction(h, e);
+    return h;
+}
+
+UnitId UnitInterner::intern(const Factors &f)
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    auto it{index.find(f)};
+    if (it != index.end())
+        return it->second;
+    if (units.size() > UINT32_MAX)
+        throw InternError();
+    UnitId id{static_cast<UnitId>(units.size())};
+    units.push_back(f);
+    index.emplace(f, id);
+    return id;
+}
+
+std::optional<UnitId> UnitInterner::find(const Factors &f) const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    auto it{index.find(f)};
+    if (it == index.end())
+        return std::nullopt;
+    return it->second;
+}
+
+// Elements of a deque stay put as it grows, so the reference outlives the
+// lock.
+const Factors &UnitInterner::get(UnitId id) const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    if (id >= units.size())
+        throw InternError();
+    return units[id];
+}
+
+std::string UnitInterner::key(UnitId id) const
+{
+    return canonical_key(get(id));
+}
+
+size_t UnitInterner::size() const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return units.size();
+}
+
+UnitInterner &UnitInterner::shared()
+{
+    static UnitInterner interner{};
+    return interner;
+}
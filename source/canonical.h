@@ -0,0 +1,57 @@
+#ifndef CANONICAL_H
+#define CANONICAL_H
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include "parser.h"
+
+class InternError
+{
+public:
+    InternError() = default;
+};
+
+// A key that identifies a Factors: base units in the order m, kg, s, A, K,
+// mol, cd, positive exponents before the "/", e.g. "m*kg/s**2" or
+// "m**(1/2)/(s*A)", with a multiplier other than 1 as a leading "(n/d)*"
+// factor, an irrational one as "(n/d)**(1/k)*", an approximate one marked
+// "~(n/d)*", and an offset as a trailing "+n/d". Every distinct Factors has its
+// own key and equal Factors share one. The grammar has no numeric factors,
+// so only keys without a multiplier or offset parse back with Parser.
+std::string canonical_key(const Factors &);
+
+// Hashes the dimension signature and the rational parts in place, without
+// building a key.
+class FactorsHash
+{
+public:
+    size_t operator()(const Factors &) const;
+};
+
+typedef uint32_t UnitId;
+
+// Gives each distinct Factors a stable id for the lifetime of the pool, so
+// that units can be compared and hashed as integers. Ids are dense and
+// start at 0; interned Factors are never removed.
+class UnitInterner
+{
+private:
+    std::deque<Factors> units{};
+    std::unordered_map<Factors, UnitId, FactorsHash> index{};
+    mutable std::mutex mutex{};
+
+public:
+    UnitInterner() = default;
+    UnitInterner(const UnitInterner &) = delete;
+    UnitInterner &operator=(const UnitInterner &) = delete;
+    UnitId intern(const Factors &);
+    std::optional<UnitId> find(const Factors &) const;
+    const Factors &get(UnitId) const;
+    std::string key(UnitId) const;
+    size_t size() const;
+    static UnitInterner &shared();
+};
+#endif // CANONICAL_H
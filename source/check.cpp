@@ -0,0 +1,629 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "canonical.h"
+#include "convert.h"
+#include "dimensions.h"
+#include "fastfactors.h"
+#include "lazy.h"
+#include "parser.h"
+#include "registry.h"
+#include "reverse.h"
+#include "serialize.h"
+#include "threadpool.h"
+
+// Behavioural checks with known answers, which the fuzz target cannot
+// give: Fraction and exact-root arithmetic, parse errors, the caches and
+// batch parsing, the thread pool, the conversion kernels, lazy expressions,
+// the dimension-only parse, canonical keys, the reverse lookup of unit
+// symbols, the unit registry and cache snapshots. `make check` builds and
+// runs them with ASan/UBSan and fails if any check does.
+
+Parser parser{};
+size_t failures{0};
+
+void check(bool condition, const std::string &what)
+{
+    if (condition)
+        return;
+    std::cerr << "FAILED: " << what << std::endl;
+    failures++;
+}
+
+const size_t SIZES[]{0, 1, 7, 8, 9, 63, 65};
+
+// Every index runs exactly once, from nested calls as well, whether the
+// pool has one worker or several.
+void check_nested(size_t nthreads)
+{
+    ThreadPool pool{nthreads};
+    const size_t outer{8};
+    const size_t inner{100};
+    std::vector<std::atomic<size_t>> counts(outer * inner);
+    pool.parallel_for(outer, [&](size_t i)
+                      { pool.parallel_for(inner, [&](size_t j)
+                                          { counts[i * inner + j]++; }); });
+    size_t wrong{0};
+    for (const auto &c : counts)
+        wrong += c != 1;
+    check(wrong == 0, "nested parallel_for on " + std::to_string(nthreads) + " threads");
+}
+
+// Every task is queued on worker 0 and waits for all of them to start,
+// which only happens if the other workers steal them.
+void check_stealing()
+{
+    const size_t nthreads{4};
+    std::mutex mutex{};
+    std::condition_variable started{};
+    size_t nstarted{0};
+    size_t nmet{0};
+    ThreadPool pool{nthreads};
+    for (size_t i = 0; i < nthreads; i++)
+        pool.submit(0, [&]
+                    {
+                        std::unique_lock<std::mutex> lock{mutex};
+                        nstarted++;
+                        started.notify_all();
+                        if (started.wait_for(lock, std::chrono::seconds(10), [&]
+                                             { return nstarted == nthreads; }))
+                            nmet++;
+                        started.notify_all(); });
+    std::unique_lock<std::mutex> lock{mutex};
+    started.wait_for(lock, std::chrono::seconds(20), [&]
+                     { return nmet == nthreads; });
+    check(nmet == nthreads, "tasks queued on one worker are stolen by the others");
+}
+
+template <typename T>
+std::vector<T> ramp(size_t n)
+{
+    std::vector<T> x(n);
+    for (size_t i = 0; i < n; i++)
+        x[i] = static_cast<T>(i % 1000) * static_cast<T>(0.37) - 100;
+    return x;
+}
+
+// Parallel and serial conversion agree byte for byte, for outputs at every
+// element offset within a cache line.
+template <typename T>
+void check_parallel(ThreadPool &pool, const ConversionPlan &plan, size_t n, const char *type)
+{
+    std::vector<T> in{ramp<T>(n)};
+    for (size_t offset = 0; offset < LINEBYTES / sizeof(T); offset++)
+    {
+        std::vector<T> serial(n + offset), parallel(n + offset);
+        std::span<T> s{serial.data() + offset, n};
+        std::span<T> p{parallel.data() + offset, n};
+        plan.apply(in, s);
+        plan.apply(in, p, pool);
+        check(n == 0 || std::memcmp(s.data(), p.data(), n * sizeof(T)) == 0,
+              std::string("parallel ") + type + " conversion of " + std::to_string(n) + " at offset " + std::to_string(offset));
+    }
+}
+
+// Runs the chunks one at a time and finds the range each one wrote: the
+// ranges tile the output in order and all but the first start on a line.
+template <typename T>
+void check_chunks(size_t n, size_t offset)
+{
+    std::vector<T> in(n, 1), buffer(n + offset);
+    std::span<T> out{buffer.data() + offset, n};
+    size_t next{0};
+    bool aligned{true};
+    Executor serial{[&](size_t nchunks, const std::function<void(size_t)> &f)
+                    {
+                        for (size_t i = 0; i < nchunks; i++)
+                        {
+                            std::fill(out.begin(), out.end(), T{0});
+                            f(i);
+                            size_t start{0};
+                            while (start < n && out[start] == 0)
+                                start++;
+                            size_t end{start};
+                            while (end < n && out[end] != 0)
+                                end++;
+                            aligned = aligned && start == next && (i == 0 || reinterpret_cast<uintptr_t>(out.data() + start) % LINEBYTES == 0);
+                            next = end;
+                        } }};
+    affine<T>(in, out, 1, 1, serial);
+    check(aligned && next == n, "chunk boundaries of " + std::to_string(n) + " at offset " + std::to_string(offset));
+}
+
+// Every kernel the CPU supports against the scalar x * scale + shift, on
+// lengths that are not a multiple of any vector width and on unaligned
+// starts of the input and output. The vector kernels fuse the multiply and
+// add, so they must equal fma(x, scale, shift) and differ from the scalar
+// result only by the rounding of the product and the sum.
+template <typename T>
+void check_kernels(const char *type)
+{
+    const T scale{static_cast<T>(1.8)};
+    const T shift{static_cast<T>(32.3)};
+    const std::pair<AffineKernel, const char *> kernels[]{
+        {AffineKernel::avx2, "avx2"},
+        {AffineKernel::avx512, "avx512"},
+        {AffineKernel::neon, "neon"},
+    };
+    std::vector<size_t> lengths{};
+    for (size_t n = 0; n <= 70; n++)
+        lengths.push_back(n);
+    for (size_t n : {size_t{127}, size_t{129}, size_t{1000}, size_t{4099}})
+        lengths.push_back(n);
+    for (auto [kernel, name] : kernels)
+    {
+        if (!affine_supported(kernel))
+            continue;
+        for (size_t n : lengths)
+            for (size_t offset = 0; offset < 8; offset += 3)
+                for (bool stream : {false, true})
+                {
+                    std::vector<T> in{ramp<T>(n + offset)};
+                    std::vector<T> scalar(n + offset), vector(n + offset);
+                    std::span<const T> x{in.data() + offset, n};
+                    affine<T>(x, std::span<T>(scalar.data() + offset, n), scale, shift, AffineKernel::scalar);
+                    affine<T>(x, std::span<T>(vector.data() + offset, n), scale, shift, kernel, stream);
+                    bool same{true};
+                    for (size_t i = 0; i < n; i++)
+                    {
+                        T s{scalar[offset + i]};
+                        T v{vector[offset + i]};
+                        T bound{std::numeric_limits<T>::epsilon() * (std::abs(x[i] * scale) + std::abs(s))};
+                        same = same && s == x[i] * scale + shift && v == std::fma(x[i], scale, shift) && std::abs(v - s) <= bound;
+                    }
+                    check(same, std::string(name) + " " + type + " kernel on " + std::to_string(n) + " at offset " +
+                                    std::to_string(offset) + (stream ? " streaming" : ""));
+                }
+    }
+}
+
+template <typename T>
+void check_convert(ThreadPool &pool, const char *type)
+{
+    ConversionPlan plan{parser.parse("degC"), parser.parse("degF")};
+    size_t chunk{CHUNKBYTES / sizeof(T)};
+    size_t parallel{PARALLELBYTES / sizeof(T)};
+    for (size_t n : SIZES)
+    {
+        check_parallel<T>(pool, plan, n, type);
+        check_parallel<T>(pool, plan, parallel + n, type);
+    }
+    check_parallel<T>(pool, plan, chunk + 1, type);
+    check_parallel<T>(pool, plan, parallel + chunk + 1, type);
+    for (size_t offset = 0; offset < LINEBYTES / sizeof(T); offset += 3)
+        check_chunks<T>(parallel + chunk + 1, offset);
+}
+
+// A fused (a*b)/c**2 converted to N against converting each input to
+// coherent SI units, then multiplying, squaring, dividing and converting
+// the result one array at a time, on lengths that span several blocks.
+template <typename T>
+void check_lazy(ThreadPool &pool, const char *type)
+{
+    Factors mm{parser.parse("mm")}, lb{parser.parse("lb")}, min{parser.parse("min")}, newton{parser.parse("N")};
+    Factors m{parser.parse("m")}, kg{parser.parse("kg")}, s{parser.parse("s")};
+    size_t parallel{PARALLELBYTES / sizeof(T)};
+    for (size_t n : {size_t{1}, size_t{255}, size_t{257}, size_t{773}, size_t{4099}, parallel + 7})
+    {
+        std::vector<T> a(n), b(n), c(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            a[i] = static_cast<T>(1 + i % 97);
+            b[i] = static_cast<T>(2 + i % 89) / 4;
+            c[i] = static_cast<T>(1 + i % 83) / 8;
+        }
+        std::vector<T> am(n), bkg(n), cs(n), eager(n), fused(n);
+        convert<T>(mm, m, a, am);
+        convert<T>(lb, kg, b, bkg);
+        convert<T>(min, s, c, cs);
+        for (size_t i = 0; i < n; i++)
+            eager[i] = am[i] * bkg[i] / std::pow(cs[i], T{2});
+        convert<T>(m * kg / (s * s), newton, eager, eager);
+        Expression<T> e{Expression<T>(a, mm) * Expression<T>(b, lb) / Expression<T>(c, min).pow(2)};
+        if (n < parallel)
+            e.evaluate(fused, newton);
+        else
+            e.evaluate(fused, newton, pool);
+        bool close{e.get_unit().same_dimension(newton)};
+        for (size_t i = 0; i < n; i++)
+            close = close && std::abs(fused[i] - eager[i]) <= 8 * std::numeric_limits<T>::epsilon() * std::abs(eager[i]);
+        check(close, std::string("fused ") + type + " expression on " + std::to_string(n));
+    }
+}
+
+template <typename E, typename F>
+bool throws(F f)
+{
+    try
+    {
+        f();
+    }
+    catch (const E &)
+    {
+        return true;
+    }
+    return false;
+}
+
+// A Fraction is big exactly when it does not fit in int64 parts, whatever
+// sequence of operations produced it, and big values made in a session
+// can be copied out after it ends.
+void check_fraction()
+{
+    const Fraction max{INT64_MAX}, min{INT64_MIN};
+    check(!max.is_big() && min.is_big() && !Fraction(-INT64_MAX).is_big(), "INT64_MIN is big and -INT64_MAX is not");
+    check(-min == max + 1 && (-min).is_big() && -(-min) == min, "negating INT64_MIN");
+    check(abs(min) == -min && abs(Fraction(-INT64_MAX)) == max && !abs(Fraction(-INT64_MAX)).is_big(), "abs of INT64_MIN and -INT64_MAX");
+    check(min / -1 == -min && min / min == 1 && !(min / min).is_big() && (min / 2).get_numerator() == INT64_MIN / 2, "dividing INT64_MIN");
+    check((max * 2).is_big() && (max + 1).is_big() && (Fraction(1, INT64_MAX) / 2).is_big(), "overflow promotes");
+    check(max * 2 / 2 == max && !(max * 2 / 2).is_big(), "a product demotes");
+    check((max + 1) - 1 == max && !((max + 1) - 1).is_big(), "a sum demotes");
+    check(Fraction(1, INT64_MAX) / 2 * 2 == Fraction(1, INT64_MAX) && !(Fraction(1, INT64_MAX) / 2 * 2).is_big(), "a quotient demotes");
+    Fraction half{2, -4};
+    check(half.get_numerator() == -1 && half.get_denominator() == 2 && half == Fraction(-1, 2), "sign and gcd normalization");
+    check(Fraction(0, -5).get_denominator() == 1 && Fraction(INT64_MIN, INT64_MIN) == 1 && !Fraction(INT64_MIN, 2).is_big(), "normalization of zero and INT64_MIN");
+    check(throws<FactorsError>([]
+                               { Fraction(1, 0); }) &&
+              throws<FactorsError>([&]
+                                   { max / Fraction(); }),
+          "zero denominator is rejected");
+    Fraction big{max * 2};
+    check(big > max && max < big && -big < -max && big != max && (big <=> Fraction(1)) == std::strong_ordering::greater, "comparing big and small");
+    Fraction kept{}, small{};
+    {
+        ParseSession session{};
+        Fraction product{max * max}, quotient{product / max};
+        session.end();
+        kept = product;
+        small = quotient;
+    }
+    check(kept.is_big() && kept / max == max && !small.is_big() && small == max, "big result outlives its session");
+}
+
+bool fails(std::string_view units, ParseStatus kind)
+{
+    ParseResult f{parser.try_parse(units)};
+    return !f && f.error().kind == kind;
+}
+
+Factors number(Fraction x)
+{
+    return Factors(std::move(x), 0, 0, 0, 0, 0, 0, 0, 0);
+}
+
+// Fractional powers stay exact while the root degree is within
+// ROOTMAXDEGREE, and results too large for POWMAXBITS or
+// MULTIPLIERMAXBITS are errors.
+void check_roots()
+{
+    check(parser.parse("(mm**(1/2))**2") == parser.parse("mm") && parser.parse("(mm**(1/2))**2").is_exact(), "(mm**(1/2))**2 is mm");
+    Factors f{parser.parse("cm**(3/2)")};
+    check(f.is_exact() && f.get_multiplier() == Fraction(1, 1000), "cm**(3/2) has multiplier 1/1000");
+    f = parser.parse("km**(1/3)");
+    check(f.is_exact() && f.get_multiplier() == 10, "km**(1/3) has multiplier 10");
+    check(fails("m**(1/0)", ParseStatus::factors_error), "m**(1/0) is a factors error");
+    Factors root{parser.parse("km**(1/2)")};
+    Factors scaled{parser.parse("m**(1/2)") * number(10).pow(number(Fraction(3, 2)))};
+    check(root.get_degree() == 2 && root == parser.parse("km**(1/2)") && root == scaled, "km**(1/2) is m**(1/2)*10**(3/2)");
+    check(parser.parse("km**(1/64)").get_degree() == 64 && parser.parse("(km**(1/8))**(1/8)") == parser.parse("km**(1/64)"), "root of degree 64 is exact");
+    check(parser.parse("km**(1/65)").get_degree() == 0 && parser.parse("(km**(1/64))**(1/2)").get_degree() == 0, "root of degree above 64 is approximate");
+    check(parser.parse("(km**10)**40").is_exact() && fails("(km**10)**41", ParseStatus::factors_error), "power beyond 4096 bits fails");
+    check(parser.parse("(km**10)**20*(km**10)**20").is_exact(), "product within 4096 bits");
+    check(fails("(km**10)**40*(km**10)**40", ParseStatus::factors_error) && fails("(km**10)**40/(mm**10)**40", ParseStatus::factors_error), "product beyond 4096 bits fails");
+}
+
+bool fails_at(std::string_view units, ParseStatus kind, size_t offset)
+{
+    ParseResult f{parser.try_parse(units)};
+    return !f && f.error().kind == kind && f.error().offset == offset;
+}
+
+// try_parse reports the kind of each error and the offset it was found
+// at: the token for token and unit errors, the operator for arithmetic,
+// the parenthesis that opens level DEPTHMAX, counting the expression
+// itself as one, and LENMAXEXPRESSION for an expression too long.
+void check_errors()
+{
+    check(fails_at("m*", ParseStatus::token_error, 2) && fails_at("m$s", ParseStatus::token_error, 1) && fails_at("m**(1/2", ParseStatus::token_error, 7), "token errors");
+    check(fails_at("xyz", ParseStatus::unknown_unit, 0) && fails_at("m*xyz", ParseStatus::unknown_unit, 2), "unknown units");
+    check(fails_at("degC*degC", ParseStatus::factors_error, 4) && fails_at("m**(1/0)", ParseStatus::factors_error, 5), "factors errors");
+    std::string deep{std::string(DEPTHMAX, '(') + "m" + std::string(DEPTHMAX, ')')};
+    check(fails_at(deep, ParseStatus::too_deep, DEPTHMAX) && parser.try_parse(deep.substr(1, deep.size() - 2)).has_value(), "nesting beyond DEPTHMAX");
+    std::string expression(LENMAXEXPRESSION, 'm');
+    check(fails_at(expression + "m", ParseStatus::too_long, LENMAXEXPRESSION) && !fails(expression, ParseStatus::too_long), "expression longer than LENMAXEXPRESSION");
+}
+
+// The NESTED and FRACTIONAL corpora of bench.cpp, and errors within them.
+const char *const DIMENSIONCORPUS[]{
+    "kg*m/(s**2*(A*(K/mol)))", "(m/(s*(s/(m*(kg)))))", "N*m/((s)*(A*(cd)))", "(((m)))/(((s)))",
+    "m**(1/2)", "km**(3/2)", "s**(-1/3)", "cm**(2/3)/s**(1/2)", "Hz**(1/2)", "(m/s)**(5/4)",
+    "kg*m/(s**2*(A*(K/xyz)))", "(m/(s*(s/(m*(kg))))", "N*m/((s)*(A*(cd))))", "(m/s)**(5/0)", "degC*(m/s)**(5/4)*degC"};
+
+// The dimension-only parse agrees with the full parse on the dimension of
+// each expression and on the kind and offset of each error.
+void check_dimensions()
+{
+    for (const char *units : DIMENSIONCORPUS)
+    {
+        ParseResult f{parser.try_parse(units)};
+        DimensionResult d{try_parse_dimensions(units)};
+        bool same{f.has_value() == d.has_value()};
+        if (same && f)
+            same = FastFactors(*f).get_dimension() == *d;
+        else if (same)
+            same = f.error().kind == d.error().kind && f.error().offset == d.error().offset;
+        check(same, std::string("dimensions of ") + units);
+    }
+}
+
+// Equal Factors, however written, share a canonical key and an interned
+// id; different Factors, including ones differing only in the multiplier,
+// the root or the offset, get different ones.
+void check_canonical()
+{
+    UnitInterner interner{};
+    Factors f{parser.parse("m/s")};
+    UnitId id{interner.intern(f)};
+    for (const char *units : {"(m)/(s)", "m*s**-1", "(s/m)**-1"})
+    {
+        Factors g{parser.parse(units)};
+        check(canonical_key(g) == canonical_key(f) && interner.intern(g) == id, std::string(units) + " is m/s");
+    }
+    check(canonical_key(f) == "m/s" && interner.get(id) == f, "key and id of m/s");
+    std::vector<std::string> keys{canonical_key(f)};
+    std::vector<UnitId> ids{id};
+    for (const char *units : {"m*s", "km/s", "km**(1/2)", "km**(1/65)", "K", "degC"})
+    {
+        Factors g{parser.parse(units)};
+        keys.push_back(canonical_key(g));
+        ids.push_back(interner.intern(g));
+    }
+    std::sort(keys.begin(), keys.end());
+    std::sort(ids.begin(), ids.end());
+    check(std::adjacent_find(keys.begin(), keys.end()) == keys.end(), "different Factors have different keys");
+    check(std::adjacent_find(ids.begin(), ids.end()) == ids.end() && interner.size() == ids.size(), "different Factors have different ids");
+}
+
+// n distinct expressions, some of each error kind, with every third one
+// repeated later in the batch.
+std::vector<std::string> batch_expressions(size_t n)
+{
+    std::vector<std::string> distinct{};
+    for (size_t i = 0; i < n; i++)
+    {
+        std::string e{"km**" + std::to_string(i % 30 + 1) + "*s**" + std::to_string(i / 30 + 1)};
+        if (i % 7 == 3)
+            e += "*xyz";
+        else if (i % 7 == 5)
+            e += "*m**(1/0)";
+        else if (i % 7 == 6)
+            e += "*";
+        distinct.push_back(e);
+    }
+    std::vector<std::string> expressions{};
+    for (size_t i = 0; i < n; i++)
+    {
+        expressions.push_back(distinct[i]);
+        if (i % 3 == 0)
+            expressions.push_back(distinct[i / 2]);
+    }
+    return expressions;
+}
+
+// parse_many parses each distinct expression once and gives every index
+// what try_parse gives it, whether the batch is parsed serially or on the
+// pool.
+void check_batch(ThreadPool &pool, size_t n)
+{
+    std::vector<std::string> expressions{batch_expressions(n)};
+    std::vector<std::string_view> views(expressions.begin(), expressions.end());
+    Parser p{}, serial{};
+    ParseBatch batch{p.parse_many(views, pool)};
+    bool same{batch.factors.size() == views.size() && batch.status.size() == views.size()};
+    for (size_t i = 0; same && i < views.size(); i++)
+    {
+        ParseResult f{serial.try_parse(views[i])};
+        same = f ? batch.status[i] == ParseStatus::ok && batch.factors[i] == *f : batch.status[i] == f.error().kind;
+    }
+    std::string what{"parse_many of " + std::to_string(n) + " expressions"};
+    check(same, what + " matches try_parse");
+    check(p.get_cache().get_misses() == n, what + " looks each up once");
+}
+
+// The cache evicts the least recently used entry, shrinks to a new
+// capacity, stores nothing at capacity 0 and counts hits and misses.
+void check_cache()
+{
+    Factors metre{parser.parse("m")}, second{parser.parse("s")}, kilogram{parser.parse("kg")};
+    ParseCache cache{2};
+    cache.insert("m", metre);
+    cache.insert("s", second);
+    check(cache.find("m") == metre, "cached entry is found");
+    cache.insert("kg", kilogram);
+    check(!cache.find("s") && cache.find("m") == metre && cache.find("kg") == kilogram, "least recently used entry is evicted");
+    std::vector<std::pair<string, Factors>> contents{cache.contents()};
+    check(contents.size() == 2 && contents[0].first == "kg" && contents[1].first == "m", "contents are most recently used first");
+    check(cache.get_hits() == 3 && cache.get_misses() == 1, "hits and misses are counted");
+    cache.set_capacity(1);
+    check(cache.size() == 1 && cache.find("kg") == kilogram && !cache.find("m"), "shrinking keeps the most recently used entry");
+    cache.set_capacity(0);
+    cache.insert("m", metre);
+    check(cache.size() == 0 && !cache.find("m"), "capacity 0 stores nothing");
+    cache.clear();
+    check(cache.get_hits() == 0 && cache.get_misses() == 0, "clear resets the counters");
+}
+
+// Threads sharing one Parser, with a cache small enough to evict while
+// they run, get what a Parser of their own would.
+void check_shared_parser()
+{
+    std::vector<std::string> expressions{batch_expressions(200)};
+    std::vector<ParseResult> expected{};
+    Parser serial{};
+    for (const std::string &e : expressions)
+        expected.push_back(serial.try_parse(e));
+    Parser p{};
+    p.get_cache().set_capacity(16);
+    std::atomic<size_t> mismatches{0};
+    std::vector<std::thread> threads{};
+    for (size_t t = 0; t < 4; t++)
+        threads.emplace_back([&, t]
+                             {
+                                 for (size_t k = 0; k < 4 * expressions.size(); k++)
+                                 {
+                                     size_t i{(k * (2 * t + 1) + t) % expressions.size()};
+                                     ParseResult f{p.try_parse(expressions[i])};
+                                     if (f.has_value() != expected[i].has_value() || (f ? *f != *expected[i] : f.error().kind != expected[i].error().kind || f.error().offset != expected[i].error().offset))
+                                         mismatches++;
+                                 } });
+    for (std::thread &thread : threads)
+        thread.join();
+    check(mismatches == 0, "parsing from four threads on one Parser");
+}
+
+// FastFactors arithmetic agrees with Factors arithmetic; a product or
+// quotient with an offset unit drops the offset in both.
+void check_modes()
+{
+    Factors degC{parser.parse("degC")}, metre{parser.parse("m")};
+    FastFactors product{FastFactors(degC) * FastFactors(metre)};
+    check(product.get_offset() == 0 && FastFactors(degC * metre) == product, "degC*m has no offset");
+    FastFactors quotient{FastFactors(degC) / FastFactors(metre)};
+    check(quotient.get_offset() == 0 && FastFactors(degC / metre) == quotient, "degC/m has no offset");
+}
+
+Factors coherent(const Factors &f)
+{
+    std::array<Fraction, 7> d{f.get_dimension()};
+    return Factors(1, 0, d[0], d[1], d[2], d[3], d[4], d[5], d[6]);
+}
+
+// Every unit in the tables parses, the symbol of an SI unit's dimension
+// parses back to its coherent unit, and prefixes for mass are chosen for
+// the gram.
+void check_reverse()
+{
+    const ReverseLookup &lookup{ReverseLookup::shared()};
+    for (const Unit &unit : NONSIUNITS)
+        check(parser.try_parse(unit.name).has_value(), std::string(unit.name) + " parses");
+    for (const Unit &unit : SIUNITS)
+    {
+        ParseResult f{parser.try_parse(unit.name)};
+        check(f.has_value(), std::string(unit.name) + " parses");
+        if (!f)
+            continue;
+        Factors c{coherent(*f)};
+        const Unit *u{lookup.find(c)};
+        check(u == nullptr || parser.parse(u->name) == c, std::string("symbol of ") + std::string(unit.name) + " parses back");
+    }
+    for (const char *units : {"m", "kg", "s", "A", "K", "mol", "cd"})
+    {
+        const Unit *u{lookup.find(parser.parse(units))};
+        check(u != nullptr && u->name == units, std::string("symbol of ") + units);
+    }
+    const Unit &kg{*SIUNITS.find("kg")};
+    check(lookup.find(coherent(parser.parse("g"))) == &kg && lookup.find(coherent(parser.parse("lb"))) == &kg, "symbol of g and lb is kg");
+    check(&ReverseLookup::prefix_base(kg) == SIUNITS.find("g"), "prefixes for kg attach to g");
+    check(ReverseLookup::suggest_prefix(1, kg) == PREFIXES.find("k"), "1 kg is written kg");
+    check(ReverseLookup::suggest_prefix(0.002, kg) == nullptr, "0.002 kg is written g");
+    check(ReverseLookup::suggest_prefix(2000, kg) == PREFIXES.find("M"), "2000 kg is written Mg");
+    check(ReverseLookup::suggest_prefix(0.002, *SIUNITS.find("m")) == PREFIXES.find("m"), "0.002 m is written mm");
+}
+
+// A registered name keeps its meaning: redefining it throws, so a cached
+// parse never goes stale, and a cache snapshot leaves it out.
+void check_registry()
+{
+    UnitRegistry registry{};
+    Parser p{registry};
+    Factors metre{parser.parse("m")};
+    registry.add("foo", metre);
+    check(p.parse("foo") == metre, "registered unit parses");
+    bool rejected{false};
+    try
+    {
+        registry.add("foo", parser.parse("kg"));
+    }
+    catch (const RegistryError &)
+    {
+        rejected = true;
+    }
+    check(rejected && p.parse("foo") == metre, "redefinition is rejected");
+    registry.add("baz", parser.parse("s"));
+    check(p.parse("foo/baz") == parser.parse("m/s"), "unit added after a parse is seen");
+    std::pair<string, Factors> contents[]{{"foo", metre}, {"m", metre}};
+    CacheSnapshot snapshot{CacheSnapshot::build(contents)};
+    check(snapshot.get_count() == 1 && !snapshot.find("foo") && snapshot.find("m") == metre, "snapshot leaves out registered units");
+}
+
+// Opening a snapshot does not decode its values; a corrupt one is a miss.
+// Entries out of order are rejected on opening.
+void check_snapshot()
+{
+    Factors metre{parser.parse("m")}, km{parser.parse("km")};
+    std::pair<string, Factors> contents[]{{"m", metre}, {"km", km}};
+    std::vector<std::byte> bytes{CacheSnapshot::build(contents)};
+    bytes.back() = std::byte{0x80};
+    try
+    {
+        CacheSnapshot snapshot{std::move(bytes)};
+        std::optional<Factors> a{snapshot.find("m")}, b{snapshot.find("km")};
+        check((!a || *a == metre) && (!b || *b == km) && (!a || !b), "corrupt snapshot value is a miss");
+    }
+    catch (...)
+    {
+        check(false, "snapshot with a corrupt value opens");
+    }
+    // Swap the two entries, which follow the 48-byte header and are 32
+    // bytes each.
+    bytes = CacheSnapshot::build(contents);
+    std::swap_ranges(bytes.begin() + 48, bytes.begin() + 80, bytes.begin() + 80);
+    bool rejected{false};
+    try
+    {
+        CacheSnapshot snapshot{std::move(bytes)};
+    }
+    catch (const SerializationError &)
+    {
+        rejected = true;
+    }
+    check(rejected, "snapshot with entries out of order is rejected");
+}
+
+int main()
+{
+    check_nested(1);
+    check_nested(4);
+    check_stealing();
+    check_fraction();
+    check_roots();
+    check_errors();
+    check_dimensions();
+    check_canonical();
+    check_cache();
+    check_shared_parser();
+    check_modes();
+    check_reverse();
+    check_registry();
+    check_snapshot();
+    ThreadPool pool{4};
+    check_batch(pool, 100);
+    check_batch(pool, 600);
+    check_kernels<float>("float");
+    check_kernels<double>("double");
+    check_convert<float>(pool, "float");
+    check_convert<double>(pool, "double");
+    check_lazy<float>(pool, "float");
+    check_lazy<double>(pool, "double");
+    std::cout << failures << " failed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "convert.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CONVERT_X86
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Above this many output bytes the result cannot stay in cache anyway, so
+// the x86 kernels bypass it with non-temporal stores.
+const size_t STREAMBYTES{size_t{8} << 20};
+
+template <typename T>
+void affine_scalar(const T *in, T *out, size_t n, T a, T b)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = in[i] * a + b;
+}
+
+// The vector kernels fuse the multiply and add, and so do their unaligned
+// heads and remainders, so that an element's result does not depend on the
+// alignment of out or on where a parallel chunk boundary falls.
+#if defined(CONVERT_X86)
+template <typename T>
+__attribute__((target("fma"))) void affine_fused(const T *in, T *out, size_t n, T a, T b)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = std::fma(in[i], a, b);
+}
+
+__attribute__((target("avx2,fma"))) void affine_avx2(const float *in, float *out, size_t n, float a, float b, bool stream)
+{
+    size_t i{0};
+    if (stream)
+        for (; i < n && (reinterpret_cast<uintptr_t>(out + i) & 31) != 0; i++)
+            affine_fused(in + i, out + i, 1, a, b);
+    __m256 va{_mm256_set1_ps(a)};
+    __m256 vb{_mm256_set1_ps(b)};
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256 x0{_mm256_fmadd_ps(_mm256_loadu_ps(in + i), va, vb)};
+        __m256 x1{_mm256_fmadd_ps(_mm256_loadu_ps(in + i + 8), va, vb)};
+        __m256 x2{_mm256_fmadd_ps(_mm256_loadu_ps(in + i + 16), va, vb)};
+        __m256 x3{_mm256_fmadd_ps(_mm256_loadu_ps(in + i + 24), va, vb)};
+        if (stream)
+        {
+            _mm256_stream_ps(out + i, x0);
+            _mm256_stream_ps(out + i + 8, x1);
+            _mm256_stream_ps(out + i + 16, x2);
+            _mm256_stream_ps(out + i + 24, x3);
+        }
+        else
+        {
+            _mm256_storeu_ps(out + i, x0);
+            _mm256_storeu_ps(out + i + 8, x1);
+            _mm256_storeu_ps(out + i + 16, x2);
+            _mm256_storeu_ps(out + i + 24, x3);
+        }
+    }
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_fmadd_ps(_mm256_loadu_ps(in + i), va, vb));
+    if (stream)
+        _mm_sfence();
+    affine_fused(in + i, out + i, n - i, a, b);
+}
+
+__attribute__((target("avx2,fma"))) void affine_avx2(const double *in, double *out, size_t n, double a, double b, bool stream)
+{
+    size_t i{0};
+    if (stream)
+        for (; i < n && (reinterpret_cast<uintptr_t>(out + i) & 31) != 0; i++)
+            affine_fused(in + i, out + i, 1, a, b);
+    __m256d va{_mm256_set1_pd(a)};
+    __m256d vb{_mm256_set1_pd(b)};
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256d x0{_mm256_fmadd_pd(_mm256_loadu_pd(in + i), va, vb)};
+        __m256d x1{_mm256_fmadd_pd(_mm256_loadu_pd(in + i + 4), va, vb)};
+        __m256d x2{_mm256_fmadd_pd(_mm256_loadu_pd(in + i + 8), va, vb)};
+        __m256d x3{_mm256_fmadd_pd(_mm256_loadu_pd(in + i + 12), va, vb)};
+        if (stream)
+        {
+            _mm256_stream_pd(out + i, x0);
+            _mm256_stream_pd(out + i + 4, x1);
+            _mm256_stream_pd(out + i + 8, x2);
+            _mm256_stream_pd(out + i + 12, x3);
+        }
+        else
+        {
+            _mm256_storeu_pd(out + i, x0);
+            _mm256_storeu_pd(out + i + 4, x1);
+            _mm256_storeu_pd(out + i + 8, x2);
+            _mm256_storeu_pd(out + i + 12, x3);
+        }
+    }
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(out + i, _mm256_fmadd_pd(_mm256_loadu_pd(in + i), va, vb));
+    if (stream)
+        _mm_sfence();
+    affine_fused(in + i, out + i, n - i, a, b);
+}
+
+__attribute__((target("avx512f"))) void affine_avx512(const float *in, float *out, size_t n, float a, float b, bool stream)
+{
+    size_t i{0};
+    if (stream)
+        for (; i < n && (reinterpret_cast<uintptr_t>(out + i) & 63) != 0; i++)
+            affine_fused(in + i, out + i, 1, a, b);
+    __m512 va{_mm512_set1_ps(a)};
+    __m512 vb{_mm512_set1_ps(b)};
+    for (; i + 32 <= n; i += 32)
+    {
+        __m512 x0{_mm512_fmadd_ps(_mm512_loadu_ps(in + i), va, vb)};
+        __m512 x1{_mm512_fmadd_ps(_mm512_loadu_ps(in + i + 16), va, vb)};
+        if (stream)
+        {
+            _mm512_stream_ps(out + i, x0);
+            _mm512_stream_ps(out + i + 16, x1);
+        }
+        else
+        {
+            _mm512_storeu_ps(out + i, x0);
+            _mm512_storeu_ps(out + i + 16, x1);
+        }
+    }
+    if (stream)
+        _mm_sfence();
+    if (i < n)
+    {
+        __mmask16 k{static_cast<__mmask16>((1u << std::min<size_t>(n - i, 16)) - 1)};
+        _mm512_mask_storeu_ps(out + i, k, _mm512_fmadd_ps(_mm512_maskz_loadu_ps(k, in + i), va, vb));
+        i += std::min<size_t>(n - i, 16);
+    }
+    affine_fused(in + i, out + i, n - i, a, b);
+}
+
+__attribute__((target("avx512f"))) void affine_avx512(const double *in, double *out, size_t n, double a, double b, bool stream)
+{
+    size_t i{0};
+    if (stream)
+        for (; i < n && (reinterpret_cast<uintptr_t>(out + i) & 63) != 0; i++)
+            affine_fused(in + i, out + i, 1, a, b);
+    __m512d va{_mm512_set1_pd(a)};
+    __m512d vb{_mm512_set1_pd(b)};
+    for (; i + 16 <= n; i += 16)
+    {
+        __m512d x0{_mm512_fmadd_pd(_mm512_loadu_pd(in + i), va, vb)};
+        __m512d x1{_mm512_fmadd_pd(_mm512_loadu_pd(in + i + 8), va, vb)};
+        if (stream)
+        {
+            _mm512_stream_pd(out + i, x0);
+            _mm512_stream_pd(out + i + 8, x1);
+        }
+        else
+        {
+            _mm512_storeu_pd(out + i, x0);
+            _mm512_storeu_pd(out + i + 8, x1);
+        }
+    }
+    if (stream)
+        _mm_sfence();
+    if (i < n)
+    {
+        __mmask8 k{static_cast<__mmask8>((1u << std::min<size_t>(n - i, 8)) - 1)};
+        _mm512_mask_storeu_pd(out + i, k, _mm512_fmadd_pd(_mm512_maskz_loadu_pd(k, in + i), va, vb));
+        i += std::min<size_t>(n - i, 8);
+    }
+    affine_fused(in + i, out + i, n - i, a, b);
+}
+#elif defined(__ARM_NEON)
+template <typename T>
+void affine_fused(const T *in, T *out, size_t n, T a, T b)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = std::fma(in[i], a, b);
+}
+
+void affine_neon(const float *in, float *out, size_t n, float a, float b)
+{
+    size_t i{0};
+    float32x4_t va{vdupq_n_f32(a)};
+    float32x4_t vb{vdupq_n_f32(b)};
+    for (; i + 16 <= n; i += 16)
+    {
+        vst1q_f32(out + i, vfmaq_f32(vb, vld1q_f32(in + i), va));
+        vst1q_f32(out + i + 4, vfmaq_f32(vb, vld1q_f32(in + i + 4), va));
+        vst1q_f32(out + i + 8, vfmaq_f32(vb, vld1q_f32(in + i + 8), va));
+        vst1q_f32(out + i + 12, vfmaq_f32(vb, vld1q_f32(in + i + 12), va));
+    }
+    for (; i + 4 <= n; i += 4)
+        vst1q_f32(out + i, vfmaq_f32(vb, vld1q_f32(in + i), va));
+    affine_fused(in + i, out + i, n - i, a, b);
+}
+
+#if defined(__aarch64__)
+void affine_neon(const double *in, double *out, size_t n, double a, double b)
+{
+    size_t i{0};
+    float64x2_t va{vdupq_n_f64(a)};
+    float64x2_t vb{vdupq_n_f64(b)};
+    for (; i + 8 <= n; i += 8)
+    {
+        vst1q_f64(out + i, vfmaq_f64(vb, vld1q_f64(in + i), va));
+        vst1q_f64(out + i + 2, vfmaq_f64(vb, vld1q_f64(in + i + 2), va));
+        vst1q_f64(out + i + 4, vfmaq_f64(vb, vld1q_f64(in + i + 4), va));
+        vst1q_f64(out + i + 6, vfmaq_f64(vb, vld1q_f64(in + i + 6), va));
+    }
+    for (; i + 2 <= n; i += 2)
+        vst1q_f64(out + i, vfmaq_f64(vb, vld1q_f64(in + i), va));
+    affine_fused(in + i, out + i, n - i, a, b);
+}
+#else
+void affine_neon(const double *in, double *out, size_t n, double a, double b)
+{
+    affine_fused(in, out, n, a, b);
+}
+#endif
+#endif
+
+bool affine_supported(AffineKernel kernel)
+{
+    switch (kernel)
+    {
+    case AffineKernel::scalar:
+        return true;
+#if defined(CONVERT_X86)
+    case AffineKernel::avx2:
+        return __builtin_cpu_supports("avx2") != 0 && __builtin_cpu_supports("fma") != 0;
+    case AffineKernel::avx512:
+        return __builtin_cpu_supports("avx512f") != 0;
+#elif defined(__ARM_NEON)
+    case AffineKernel::neon:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+template <typename T>
+void affine_kernel(const T *in, T *out, size_t n, T scale, T shift, bool stream, AffineKernel kernel)
+{
+    switch (kernel)
+    {
+#if defined(CONVERT_X86)
+    case AffineKernel::avx512:
+        return affine_avx512(in, out, n, scale, shift, stream);
+    case AffineKernel::avx2:
+        return affine_avx2(in, out, n, scale, shift, stream);
+#elif defined(__ARM_NEON)
+    case AffineKernel::neon:
+        return affine_neon(in, out, n, scale, shift);
+#endif
+    default:
+        return affine_scalar(in, out, n, scale, shift);
+    }
+}
+
+AffineKernel widest_kernel()
+{
+    for (AffineKernel kernel : {AffineKernel::avx512, AffineKernel::avx2, AffineKernel::neon})
+        if (affine_supported(kernel))
+            return kernel;
+    return AffineKernel::scalar;
+}
+
+template <typename T>
+void affine_kernel(const T *in, T *out, size_t n, T scale, T shift, bool stream)
+{
+    static const AffineKernel kernel{widest_kernel()};
+    affine_kernel(in, out, n, scale, shift, stream, kernel);
+}
+
+template <typename T>
+void affine(std::span<const T> in, std::span<T> out, T scale, T shift)
+{
+    if (out.size() != in.size())
+        throw ConversionError();
+    bool stream{in.data() != out.data() && in.size() * sizeof(T) >= STREAMBYTES};
+    affine_kernel(in.data(), out.data(), in.size(), scale, shift, stream);
+}
+
+template <typename T>
+void affine(std::span<const T> in, std::span<T> out, T scale, T shift, AffineKernel kernel, bool stream)
+{
+    if (out.size() != in.size() || !affine_supported(kernel))
+        throw ConversionError();
+    affine_kernel(in.data(), out.data(), in.size(), scale, shift, stream, kernel);
+}
+
+// Chunks after the first start on a cache line of the output, so no two
+// threads write the same line.
+template <typename T>
+void affine(std::span<const T> in, std::span<T> out, T scale, T shift, const Executor &executor)
+{
+    if (out.size() != in.size())
+        throw ConversionError();
+    size_t n{in.size()};
+    if (n * sizeof(T) < PARALLELBYTES)
+        return affine(in, out, scale, shift);
+    bool stream{in.data() != out.data()};
+    size_t chunk{CHUNKBYTES / sizeof(T)};
+    size_t head{(LINEBYTES - reinterpret_cast<uintptr_t>(out.data()) % LINEBYTES) % LINEBYTES / sizeof(T)};
+    size_t nchunks{(n - head + chunk - 1) / chunk};
+    executor(nchunks, [&](size_t i)
+             {
+                 size_t start{i == 0 ? 0 : head + i * chunk};
+                 size_t end{std::min(n, head + (i + 1) * chunk)};
+                 affine_kernel(in.data() + start, out.data() + start, end - start, scale, shift, stream); });
+}
+
+ConversionPlan::ConversionPlan(const Factors &from, const Factors &to)
+{
+    if (!from.same_dimension(to))
+        throw FactorsError();
+    exact_scale = from.get_multiplier() / to.get_multiplier();
+    exact_shift = from.get_offset() * exact_scale - to.get_offset();
+    scale = static_cast<double>(exact_scale);
+    shift = static_cast<double>(exact_shift);
+    scalef = static_cast<float>(exact_scale);
+    shiftf = static_cast<float>(exact_shift);
+}
+
+template <typename T>
+void apply_plan(const ConversionPlan &plan, std::span<const T> in, std::span<T> out, T scale, T shift, const Executor *executor)
+{
+    if (!plan.is_identity())
+        return executor != nullptr ? affine(in, out, scale, shift, *executor) : affine(in, out, scale, shift);
+    if (out.size() != in.size())
+        throw ConversionError();
+    if (in.data() != out.data())
+        std::copy(in.begin(), in.end(), out.begin());
+}
+
+void ConversionPlan::apply(std::span<const float> in, std::span<float> out) const
+{
+    apply_plan(*this, in, out, scalef, shiftf, nullptr);
+}
+
+void ConversionPlan::apply(std::span<const double> in, std::span<double> out) const
+{
+    apply_plan(*this, in, out, scale, shift, nullptr);
+}
+
+void ConversionPlan::apply(std::span<const float> in, std::span<float> out, const Executor &executor) const
+{
+    apply_plan(*this, in, out, scalef, shiftf, &executor);
+}
+
+void ConversionPlan::apply(std::span<const double> in, std::span<double> out, const Executor &executor) const
+{
+    apply_plan(*this, in, out, scale, shift, &executor);
+}
+
+template <typename T>
+void convert(const Factors &from, const Factors &to, std::span<const T> in, std::span<T> out)
+{
+    ConversionPlan(from, to).apply(in, out);
+}
+
+template void affine(std::span<const float>, std::span<float>, float, float);
+template void affine(std::span<const double>, std::span<double>, double, double);
+template void affine(std::span<const float>, std::span<float>, float, float, const Executor &);
+template void affine(std::span<const double>, std::span<double>, double, double, const Executor &);
+template void affine(std::span<const float>, std::span<float>, float, float, AffineKernel, bool);
+template void affine(std::span<const double>, std::span<double>, double, double, AffineKernel, bool);
+template void convert(const Factors &, const Factors &, std::span<const float>, std::span<float>);
+template void convert(const Factors &, const Factors &, std::span<const double>, std::span<double>);
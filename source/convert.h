@@ -0,0 +1,69 @@
+#ifndef CONVERT_H
+#define CONVERT_H
+#include <span>
+#include "parser.h"
+#include "threadpool.h"
+
+// Parallel conversion splits arrays of at least PARALLELBYTES into chunks
+// whose input and output fit together in a typical L2 cache. Chunks after
+// the first start on a LINEBYTES boundary of the output.
+const size_t PARALLELBYTES{size_t{4} << 20};
+const size_t CHUNKBYTES{size_t{256} << 10};
+const size_t LINEBYTES{64};
+
+class ConversionError
+{
+public:
+    ConversionError() = default;
+};
+
+// The kernels behind affine, which runs the widest one the CPU supports.
+// The vector kernels compute fma(x, scale, shift) for every element, the
+// scalar one x * scale + shift. Choosing a kernel explicitly is for
+// checking them against each other; an unsupported one throws.
+enum class AffineKernel : uint8_t
+{
+    scalar,
+    avx2,
+    avx512,
+    neon
+};
+
+bool affine_supported(AffineKernel);
+template <typename T>
+void affine(std::span<const T> in, std::span<T> out, T scale, T shift);
+template <typename T>
+void affine(std::span<const T> in, std::span<T> out, T scale, T shift, const Executor &);
+template <typename T>
+void affine(std::span<const T> in, std::span<T> out, T scale, T shift, AffineKernel, bool stream = false);
+
+class ConversionPlan
+{
+private:
+    Fraction exact_scale{1};
+    Fraction exact_shift{0};
+    double scale{1};
+    double shift{0};
+    float scalef{1};
+    float shiftf{0};
+
+public:
+    ConversionPlan() = default;
+    ConversionPlan(const Factors &from, const Factors &to);
+    const Fraction &get_exact_scale() const { return exact_scale; }
+    const Fraction &get_exact_shift() const { return exact_shift; }
+    double get_scale() const { return scale; }
+    double get_shift() const { return shift; }
+    bool is_identity() const { return exact_scale == 1 && exact_shift == 0; }
+    double operator()(double x) const { return x * scale + shift; }
+    void apply(std::span<const float> in, std::span<float> out) const;
+    void apply(std::span<const double> in, std::span<double> out) const;
+    void apply(std::span<const float> in, std::span<float> out, const Executor &) const;
+    void apply(std::span<const double> in, std::span<double> out, const Executor &) const;
+    void apply(std::span<const float> in, std::span<float> out, ThreadPool &pool) const { apply(in, out, pool.executor()); }
+    void apply(std::span<const double> in, std::span<double> out, ThreadPool &pool) const { apply(in, out, pool.executor()); }
+};
+
+template <typename T>
+void convert(const Factors &from, const Factors &to, std::span<const T> in, std::span<T> out);
+#endif // CONVERT_H
@@ -0,0 +1,160 @@
+#include <numeric>
+#include "dimensions.h"
+#include "grammar.h"
+#include "registry.h"
+
+// An exponent as an int64 rational in lowest terms. Unlike Fraction it is
+// never promoted: an operation whose result does not fit returns false, so
+// that overflow is a parse status and nothing is allocated.
+class Power
+{
+public:
+    int64_t num{0};
+    int64_t den{1};
+
+    Power() = default;
+    Power(int64_t n) : num{n} {}
+
+    bool set(int64_t n, int64_t d)
+    {
+        if (d == 0 || n == INT64_MIN || d == INT64_MIN)
+            return false;
+        if (d < 0)
+        {
+            n = -n;
+            d = -d;
+        }
+        int64_t g{d == 1 ? 1 : std::gcd(n, d)};
+        num = n / g;
+        den = d / g;
+        return true;
+    }
+
+    bool add(const Power &o, bool subtract)
+    {
+        int64_t x{}, y{}, n{}, d{};
+        if (den == 1 && o.den == 1)
+            return !(subtract ? __builtin_sub_overflow(num, o.num, &n) : __builtin_add_overflow(num, o.num, &n)) && set(n, 1);
+        int64_t g{std::gcd(den, o.den)};
+        if (__builtin_mul_overflow(num, o.den / g, &x) ||
+            __builtin_mul_overflow(o.num, den / g, &y) ||
+            (subtract ? __builtin_sub_overflow(x, y, &n) : __builtin_add_overflow(x, y, &n)) ||
+            __builtin_mul_overflow(den / g, o.den, &d))
+            return false;
+        return set(n, d);
+    }
+
+    bool multiply(const Power &o, bool divide)
+    {
+        int64_t on{divide ? o.den : o.num};
+        int64_t od{divide ? o.num : o.den};
+        if (od == 0)
+            return false;
+        if (num == 0)
+            return true;
+        int64_t n{}, d{};
+        if (den == 1 && od == 1)
+            return !__builtin_mul_overflow(num, on, &n) && set(n, 1);
+        int64_t g{std::gcd(num, od)};
+        int64_t h{std::gcd(on, den)};
+        if (__builtin_mul_overflow(num / g, on / h, &n) || __builtin_mul_overflow(den / h, od / g, &d))
+            return false;
+        return set(n, d);
+    }
+
+    Power operator-() const
+    {
+        Power p{*this};
+        p.num = -p.num;
+        return p;
+    }
+};
+
+// What the grammar needs of a value to check dimensions: the seven base
+// exponents, whether the leftmost factor carries an offset, and the
+// multiplier only while the value is a number that may become an exponent.
+class Dimensioned
+{
+private:
+    std::array<Power, 7> exponents{};
+    Power multiplier{1};
+    bool offset{false};
+
+    bool combine(const Dimensioned &o, bool divide)
+    {
+        if ((offset && o.offset) || !multiplier.multiply(o.multiplier, divide))
+            return false;
+        for (size_t i = 0; i < exponents.size(); i++)
+            if (!exponents[i].add(o.exponents[i], divide))
+                return false;
+        return true;
+    }
+
+public:
+    Dimensioned() = default;
+    explicit Dimensioned(const Unit &u) : exponents{u.m, u.kg, u.s, u.A, u.K, u.mol, u.cd}, offset{u.offset.value != 0} {}
+    Dimensioned(const Unit &base, const Prefix &) : Dimensioned{base} {}
+
+    bool try_assign(const Factors &f)
+    {
+        std::array<Fraction, 7> d{f.get_dimension()};
+        for (size_t i = 0; i < exponents.size(); i++)
+            if (d[i].is_big() || !exponents[i].set(d[i].get_numerator(), d[i].get_denominator()))
+                return false;
+        offset = f.has_offset();
+        return true;
+    }
+    const Power &get_multiplier() const { return multiplier; }
+    void set_multiplier(const Power &p) { multiplier = p; }
+    bool try_multiply(const Dimensioned &o) { return combine(o, false); }
+    bool try_divide(const Dimensioned &o) { return combine(o, true); }
+    bool try_pow(const Dimensioned &e)
+    {
+        if (offset)
+            return false;
+        for (Power &p : exponents)
+            if (!p.multiply(e.multiplier, false))
+                return false;
+        return true;
+    }
+
+    bool to_dimension(Dimension &d) const
+    {
+        std::array<Exponent, 7> e{};
+        for (size_t i = 0; i < exponents.size(); i++)
+        {
+            const Power &p{exponents[i]};
+            if (p.num < INT8_MIN || p.num > INT8_MAX || p.den > INT8_MAX)
+                return false;
+            e[i] = Exponent(static_cast<int32_t>(p.num), static_cast<int32_t>(p.den));
+        }
+        d = Dimension{e[0], e[1], e[2], e[3], e[4], e[5], e[6]};
+        return true;
+    }
+};
+
+DimensionResult try_parse_dimensions(std::string_view units)
+{
+    return try_parse_dimensions(units, UnitRegistry::shared().local());
+}
+
+DimensionResult try_parse_dimensions(std::string_view units, const RegistrySnapshot *registry)
+{
+    Grammar<Dimensioned>::Result f{Grammar<Dimensioned>::parse(units, registry)};
+    if (!f)
+        return std::unexpected(f.error());
+    Dimension d{};
+    if (!f->to_dimension(d))
+        return std::unexpected(ParseError{ParseStatus::factors_error, 0});
+    return d;
+}
+
+Dimension parse_dimensions(std::string_view units)
+{
+    DimensionResult d{try_parse_dimensions(units)};
+    if (d)
+        return *d;
+    if (d.error().kind == ParseStatus::factors_error)
+        throw FactorsError();
+    throw TokenError();
+}
@@ -0,0 +1,19 @@
+#ifndef DIMENSIONS_H
+#define DIMENSIONS_H
+#include <expected>
+#include <string_view>
+#include "fastfactors.h"
+
+typedef std::expected<Dimension, ParseError> DimensionResult;
+
+// The Parser grammar tracking only the seven base exponents and whether the
+// leftmost factor carries an offset. It reports the same errors at the same
+// offsets as a full parse, except that multipliers are never computed, so
+// the exact-power limits of Factors::pow do not apply. Exponents are carried
+// as int64 rationals, and a result outside the int8 rationals of Dimension
+// is a factors_error at offset 0. try_parse_dimensions neither allocates
+// nor throws.
+DimensionResult try_parse_dimensions(std::string_view);
+DimensionResult try_parse_dimensions(std::string_view, const RegistrySnapshot *);
+Dimension parse_dimensions(std::string_view);
+#endif // DIMENSIONS_H
@@ -0,0 +1,80 @@
+#include <cmath>
+#include <sstream>
+#include "fastfactors.h"
+
+Exponent to_exponent(const Fraction &f)
+{
+    int64_t n{f.get_numerator()};
+    int64_t d{f.get_denominator()};
+    if (f.is_big() || n < INT8_MIN || n > INT8_MAX || d > INT8_MAX)
+        throw FactorsError();
+    return Exponent(static_cast<int32_t>(n), static_cast<int32_t>(d));
+}
+
+double to_double(const Fraction &f)
+{
+    double x{static_cast<double>(f)};
+    if (!std::isfinite(x) || (x == 0 && f != 0))
+        throw FactorsError();
+    return x;
+}
+
+Fraction to_fraction(Exponent e)
+{
+    return Fraction(e.numerator(), e.denominator());
+}
+
+FastFactors::FastFactors(const Factors &f)
+    : multiplier{to_double(f.multiplier)},
+      offset{to_double(f.offset)},
+      dimension{to_exponent(f.m), to_exponent(f.kg), to_exponent(f.s), to_exponent(f.A), to_exponent(f.K), to_exponent(f.mol), to_exponent(f.cd)}
+{
+}
+
+Factors FastFactors::to_factors() const
+{
+    if (!std::isfinite(multiplier) || !std::isfinite(offset))
+        throw FactorsError();
+    return Factors(Fraction(multiplier),
+                   Fraction(offset),
+                   to_fraction(dimension.m),
+                   to_fraction(dimension.kg),
+                   to_fraction(dimension.s),
+                   to_fraction(dimension.A),
+                   to_fraction(dimension.K),
+                   to_fraction(dimension.mol),
+                   to_fraction(dimension.cd));
+}
+
+std::ostream &operator<<(std::ostream &os, const Exponent &e)
+{
+    os << static_cast<int32_t>(e.numerator());
+    if (!e.is_integer())
+        os << "/" << static_cast<int32_t>(e.denominator());
+    return os;
+}
+
+std::ostream &operator<<(std::ostream &os, const FastFactors &f)
+{
+    std::ostringstream oss{};
+    oss << "FastFactors(multiplier="
+        << f.multiplier
+        << ", offset="
+        << f.offset
+        << ", m="
+        << f.dimension.m
+        << ", kg="
+        << f.dimension.kg
+        << ", s="
+        << f.dimension.s
+        << ", A="
+        << f.dimension.A
+        << ", K="
+        << f.dimension.K
+        << ", mol="
+        << f.dimension.mol
+        << ", cd="
+        << f.dimension.cd
+        << ")";
+    return os << oss.str();
+}
@@ -0,0 +1,158 @@
+#ifndef FASTFACTORS_H
+#define FASTFACTORS_H
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <type_traits>
+#include "parser.h"
+
+// Members are public so that Dimension is a structural type and can be used
+// as a template argument; construct through reduce to keep them normalized.
+class Exponent
+{
+public:
+    int8_t num{0};
+    int8_t den{1};
+
+private:
+    static constexpr Exponent reduce(int32_t n, int32_t d)
+    {
+        if (d == 0)
+            throw FactorsError();
+        if (d < 0)
+        {
+            n = -n;
+            d = -d;
+        }
+        int32_t g{std::gcd(n, d)};
+        if (g > 1)
+        {
+            n /= g;
+            d /= g;
+        }
+        if (n < INT8_MIN || n > INT8_MAX || d > INT8_MAX)
+            throw FactorsError();
+        Exponent e{};
+        e.num = static_cast<int8_t>(n);
+        e.den = static_cast<int8_t>(d);
+        return e;
+    }
+
+public:
+    constexpr Exponent() = default;
+    constexpr Exponent(int32_t n, int32_t d = 1) : Exponent{reduce(n, d)} {}
+    constexpr int8_t numerator() const { return num; }
+    constexpr int8_t denominator() const { return den; }
+    constexpr Exponent operator+(Exponent o) const { return reduce(int32_t{num} * o.den + int32_t{o.num} * den, int32_t{den} * o.den); }
+    constexpr Exponent operator-(Exponent o) const { return reduce(int32_t{num} * o.den - int32_t{o.num} * den, int32_t{den} * o.den); }
+    constexpr Exponent operator*(Exponent o) const { return reduce(int32_t{num} * o.num, int32_t{den} * o.den); }
+    constexpr Exponent operator/(Exponent o) const { return reduce(int32_t{num} * o.den, int32_t{den} * o.num); }
+    constexpr Exponent operator-() const { return reduce(-int32_t{num}, den); }
+    constexpr bool operator==(const Exponent &) const = default;
+    constexpr bool is_integer() const { return den == 1; }
+    friend std::ostream &operator<<(std::ostream &, const Exponent &);
+};
+
+class Dimension
+{
+public:
+    Exponent m{};
+    Exponent kg{};
+    Exponent s{};
+    Exponent A{};
+    Exponent K{};
+    Exponent mol{};
+    Exponent cd{};
+
+    constexpr Dimension operator*(const Dimension &o) const { return {m + o.m, kg + o.kg, s + o.s, A + o.A, K + o.K, mol + o.mol, cd + o.cd}; }
+    constexpr Dimension operator/(const Dimension &o) const { return {m - o.m, kg - o.kg, s - o.s, A - o.A, K - o.K, mol - o.mol, cd - o.cd}; }
+    constexpr Dimension pow(Exponent e) const { return {m * e, kg * e, s * e, A * e, K * e, mol * e, cd * e}; }
+    constexpr bool operator==(const Dimension &) const = default;
+};
+
+constexpr double integer_power(double x, int32_t n)
+{
+    if (n < 0)
+        return 1 / integer_power(x, -n);
+    double result{1};
+    while (n > 0)
+    {
+        if (n & 1)
+            result *= x;
+        x *= x;
+        n >>= 1;
+    }
+    return result;
+}
+
+// Newton iteration from above, stopping once it no longer decreases.
+constexpr double positive_root(double x, int32_t n)
+{
+    if (x == 0 || n == 1)
+        return x;
+    double r{x > 1 ? x : 1};
+    for (int i = 0; i < 256; i++)
+    {
+        double next{((n - 1) * r + x / integer_power(r, n - 1)) / n};
+        if (next >= r)
+            break;
+        r = next;
+    }
+    return r;
+}
+
+Exponent to_exponent(const Fraction &);
+
+class FastFactors
+{
+private:
+    double multiplier{1};
+    double offset{0};
+    Dimension dimension{};
+
+public:
+    constexpr FastFactors() = default;
+    constexpr FastFactors(double multiplier, double offset, Dimension dimension) : multiplier{multiplier}, offset{offset}, dimension{dimension} {}
+    constexpr explicit FastFactors(const Unit &u)
+        : multiplier{u.multiplier.value},
+          offset{u.offset.value},
+          dimension{u.m, u.kg, u.s, u.A, u.K, u.mol, u.cd} {}
+    explicit FastFactors(const Factors &);
+    Factors to_factors() const;
+    constexpr double get_multiplier() const { return multiplier; }
+    constexpr double get_offset() const { return offset; }
+    constexpr Dimension get_dimension() const { return dimension; }
+    constexpr bool same_dimension(const FastFactors &o) const { return dimension == o.dimension; }
+    constexpr bool operator==(const FastFactors &) const = default;
+    constexpr FastFactors operator*(const FastFactors &o) const
+    {
+        if (offset != 0 && o.offset != 0)
+            throw FactorsError();
+        return FastFactors(multiplier * o.multiplier, 0, dimension * o.dimension);
+    }
+    constexpr FastFactors operator/(const FastFactors &o) const
+    {
+        if (offset != 0 && o.offset != 0)
+            throw FactorsError();
+        return FastFactors(multiplier / o.multiplier, 0, dimension / o.dimension);
+    }
+    constexpr FastFactors pow(Exponent e) const
+    {
+        if (offset != 0 || multiplier < 0)
+            throw FactorsError();
+        double x{};
+        if consteval
+        {
+            x = integer_power(positive_root(multiplier, e.denominator()), e.numerator());
+        }
+        else
+        {
+            x = std::pow(multiplier, static_cast<double>(e.numerator()) / e.denominator());
+        }
+        return FastFactors(x, 0, dimension.pow(e));
+    }
+    friend std::ostream &operator<<(std::ostream &, const FastFactors &);
+};
+
+static_assert(std::is_trivially_copyable_v<FastFactors>);
+#endif // FASTFACTORS_H
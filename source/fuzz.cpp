@@ -0,0 +1,87 @@
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+#include "canonical.h"
+#include "dimensions.h"
+#include "fastfactors.h"
+#include "parser.h"
+#include "serialize.h"
+
+// libFuzzer entry point, also driven by fuzzmain.cpp for AFL and replay.
+// Besides crashes and sanitizer reports it checks that the cached and
+// uncached parses agree, that the dimension-only grammar reaches the same
+// verdict, and that a result survives the binary encoding.
+
+void check(bool condition)
+{
+    if (!condition)
+        std::abort();
+}
+
+bool is_factors_error(const ParseResult &r)
+{
+    return !r && r.error().kind == ParseStatus::factors_error;
+}
+
+bool is_factors_error(const DimensionResult &r)
+{
+    return !r && r.error().kind == ParseStatus::factors_error;
+}
+
+// Exponents beyond the int8 rationals of Dimension are only comparable
+// through the full parse.
+void check_dimensions(const ParseResult &f, const DimensionResult &d)
+{
+    if (is_factors_error(f) || is_factors_error(d))
+        return;
+    check(f.has_value() == d.has_value());
+    if (!f)
+    {
+        check(f.error().kind == d.error().kind && f.error().offset == d.error().offset);
+        return;
+    }
+    std::array<Fraction, 7> e{f->get_dimension()};
+    try
+    {
+        Dimension x{to_exponent(e[0]), to_exponent(e[1]), to_exponent(e[2]), to_exponent(e[3]), to_exponent(e[4]), to_exponent(e[5]), to_exponent(e[6])};
+        check(x == *d);
+    }
+    catch (const FactorsError &)
+    {
+    }
+}
+
+void check_encoding(const Factors &f)
+{
+    std::string bytes{};
+    encode_factors(f, bytes);
+    size_t pos{0};
+    Factors g{decode_factors(std::as_bytes(std::span(bytes)), pos)};
+    check(pos == bytes.size() && g == f);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static Parser parser{};
+    std::string_view units{reinterpret_cast<const char *>(data), size};
+    try
+    {
+        ParseResult f{Parser::try_parse_uncached(units)};
+        ParseResult g{parser.try_parse(units)};
+        check(f.has_value() == g.has_value());
+        if (f)
+        {
+            check(*f == *g);
+            check_encoding(*f);
+            canonical_key(*f);
+        }
+        else
+            check(f.error().kind == g.error().kind && f.error().offset == g.error().offset);
+        check_dimensions(f, try_parse_dimensions(units));
+    }
+    catch (...)
+    {
+        std::abort();
+    }
+    return 0;
+}
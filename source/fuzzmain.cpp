@@ -0,0 +1,86 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "tables.h"
+
+// fuzzdriver [file | directory ...]  run every input once
+// fuzzdriver -seeds directory        write a seed corpus from the unit tables
+// fuzzdriver                         run one input from stdin, as AFL does
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *, size_t);
+
+const char *const SEEDSHAPES[]{
+    "kg*m/s**2",
+    "m**(1/2)",
+    "km**(-3/2)",
+    "(m/(s*(A*(K/mol))))",
+    "m**-2*s",
+    "degC*m",
+    "(m)**((2*3)/(4))",
+};
+
+void run(const std::string &input)
+{
+    LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t *>(input.data()), input.size());
+}
+
+std::string read_file(const std::filesystem::path &path)
+{
+    std::ifstream in{path, std::ios::binary};
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void write_seeds(const std::filesystem::path &directory)
+{
+    std::vector<std::string> seeds{};
+    for (const Unit &u : SIUNITS)
+        seeds.emplace_back(u.name);
+    for (const Unit &u : NONSIUNITS)
+        seeds.emplace_back(u.name);
+    for (const Prefix &p : PREFIXES)
+        seeds.push_back(std::string(p.name) + "m");
+    for (const char *s : SEEDSHAPES)
+        seeds.emplace_back(s);
+    std::filesystem::create_directories(directory);
+    for (size_t i = 0; i < seeds.size(); i++)
+        std::ofstream(directory / ("seed" + std::to_string(i)), std::ios::binary) << seeds[i];
+    std::cout << seeds.size() << " seeds" << std::endl;
+}
+
+int main(int32_t argc, char **argv)
+{
+    if (argc == 3 && argv[1] == std::string_view("-seeds"))
+    {
+        write_seeds(argv[2]);
+        return 0;
+    }
+    if (argc == 1)
+    {
+        run(std::string(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>()));
+        return 0;
+    }
+    size_t count{0};
+    for (int32_t i = 1; i < argc; i++)
+    {
+        std::filesystem::path path{argv[i]};
+        if (std::filesystem::is_directory(path))
+        {
+            for (const auto &entry : std::filesystem::directory_iterator(path))
+                if (entry.is_regular_file())
+                {
+                    run(read_file(entry.path()));
+                    count++;
+                }
+        }
+        else
+        {
+            run(read_file(path));
+            count++;
+        }
+    }
+    std::cout << count << " inputs" << std::endl;
+}
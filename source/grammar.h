@@ -0,0 +1,226 @@
+#ifndef GRAMMAR_H
+#define GRAMMAR_H
+#include <expected>
+#include <string_view>
+#include "parser.h"
+#include "registry.h"
+#include "stats.h"
+#include "trie.h"
+
+// The grammar of unit expressions, shared by every parse over the value V
+// it accumulates. A number is a dimensionless V whose multiplier is the
+// number, so an exponent is read as the multiplier of a V. V provides
+//
+//     explicit V(const Unit &)
+//     V(const Unit &, const Prefix &)
+//     bool try_assign(const Factors &)
+//     get_multiplier() and set_multiplier(int64_t)
+//     bool try_multiply(const V &), try_divide(const V &), try_pow(const V &)
+//
+// where each try_ returns false when its result is not representable, so
+// that every error, with its offset, is a ParseResult-style status rather
+// than an exception. Instantiated over a literal V the grammar also runs in
+// constant expressions, where only the builtin tables are searched.
+template <typename V>
+class Grammar
+{
+public:
+    typedef std::expected<V, ParseError> Result;
+
+    static constexpr Result parse(std::string_view units, const RegistrySnapshot *registry)
+    {
+        if (units.size() > LENMAXEXPRESSION)
+            return fail(ParseStatus::too_long, LENMAXEXPRESSION);
+        TokenStream ts{units, registry};
+        Result f{get_expression(ts)};
+        if (ts.get_error())
+            return std::unexpected(*ts.get_error());
+        return f;
+    }
+
+private:
+    static constexpr Result fail(ParseStatus kind, size_t offset)
+    {
+        return std::unexpected(ParseError{kind, offset});
+    }
+
+    static constexpr Result get_expression(TokenStream &ts)
+    {
+        Nesting nesting{ts};
+        if !consteval
+        {
+            NUBIVIS_DEPTH(ts.get_depth());
+        }
+        if (nesting.exceeded())
+            return fail(ParseStatus::too_deep, ts.get_offset());
+        Result f{get_term(ts)};
+        if (!f)
+            return f;
+        Token t{ts.get()};
+        while (true)
+        {
+            if (t == "*" || t == "/")
+            {
+                Result g{get_term(ts)};
+                if (!g)
+                    return g;
+                if (!(t == "*" ? f->try_multiply(*g) : f->try_divide(*g)))
+                    return fail(ParseStatus::factors_error, t.offset());
+            }
+            else if (t == "")
+                break;
+            else
+            {
+                ts.putback(t);
+                break;
+            }
+            t = ts.get();
+        }
+        return f;
+    }
+
+    static constexpr Result get_term(TokenStream &ts)
+    {
+        Result f{get_unit(ts)};
+        if (!f)
+            return f;
+        Token t{ts.get()};
+        while (true)
+        {
+            if (t == "**")
+            {
+                Result g{get_numberterm(ts)};
+                if (!g)
+                    return g;
+                if (!f->try_pow(*g))
+                    return fail(ParseStatus::factors_error, t.offset());
+            }
+            else
+            {
+                ts.putback(t);
+                break;
+            }
+            t = ts.get();
+        }
+        return f;
+    }
+
+    static constexpr Result get_unit(TokenStream &ts)
+    {
+        Token t{ts.get()};
+        UnitMatch match{};
+        if consteval
+        {
+            match = match_unit(t.view());
+        }
+        else
+        {
+            NUBIVIS_COUNT(unit_lookups);
+            match = UnitTrie::builtin().find(t.view());
+            if (match.ambiguous())
+                NUBIVIS_COUNT(ambiguous_matches);
+        }
+        if (match.unit != nullptr)
+            return V(*match.unit);
+        if !consteval
+        {
+            if (ts.get_registry() != nullptr)
+                if (const Factors *u{ts.get_registry()->find(t.view())})
+                {
+                    V f{};
+                    if (!f.try_assign(*u))
+                        return fail(ParseStatus::factors_error, t.offset());
+                    return f;
+                }
+        }
+        if (match.prefix != nullptr)
+        {
+            if !consteval
+            {
+                NUBIVIS_COUNT(prefix_fallbacks);
+            }
+            return V(*match.base, *match.prefix);
+        }
+        if (t == "(")
+        {
+            Result f{get_expression(ts)};
+            if (!f)
+                return f;
+            t = ts.get();
+            if (t != ")")
+                return fail(ParseStatus::token_error, t.offset());
+            return f;
+        }
+        if (t.size() > 0 && letter_length(t.view(), 0) > 0)
+            return fail(ParseStatus::unknown_unit, t.offset());
+        return fail(ParseStatus::token_error, t.offset());
+    }
+
+    static constexpr Result get_numberterm(TokenStream &ts, bool inpar = false)
+    {
+        Result f{get_number(ts)};
+        if (!f)
+            return f;
+        Token t{ts.get()};
+        while (true)
+        {
+            if (inpar && (t == "/" || t == "*"))
+            {
+                Result g{get_number(ts)};
+                if (!g)
+                    return g;
+                if (!(t == "*" ? f->try_multiply(*g) : f->try_divide(*g)))
+                    return fail(ParseStatus::factors_error, t.offset());
+            }
+            else
+            {
+                ts.putback(t);
+                break;
+            }
+            t = ts.get();
+        }
+        return f;
+    }
+
+    static constexpr Result get_number(TokenStream &ts)
+    {
+        Nesting nesting{ts};
+        if !consteval
+        {
+            NUBIVIS_DEPTH(ts.get_depth());
+        }
+        if (nesting.exceeded())
+            return fail(ParseStatus::too_deep, ts.get_offset());
+        Token t{ts.get()};
+        if (t == "(")
+        {
+            Result f{get_numberterm(ts, true)};
+            if (!f)
+                return f;
+            t = ts.get();
+            if (t != ")")
+                return fail(ParseStatus::token_error, t.offset());
+            return f;
+        }
+        if (t.size() > 0 && t.isdecimal())
+        {
+            int64_t n{0};
+            for (char ch : t.view())
+                n = n * 10 + (ch - '0');
+            V f{};
+            f.set_multiplier(n);
+            return f;
+        }
+        if (t == "-")
+        {
+            Result f{get_number(ts)};
+            if (f)
+                f->set_multiplier(-f->get_multiplier());
+            return f;
+        }
+        if (t == "+")
+            return get_number(ts);
+        return fail(ParseStatus::token_error, t.offset());
+    }
+};
+#endif // GRAMMAR_H
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "lazy.h"
+
+// Every step of a block works on BLOCKBYTES per operand, so the whole
+// operand stack of a typical expression stays in L1.
+const size_t BLOCKBYTES{size_t{2} << 10};
+
+Factors coherent_unit(const Factors &f)
+{
+    std::array<Fraction, 7> d{f.get_dimension()};
+    return Factors(1, 0, d[0], d[1], d[2], d[3], d[4], d[5], d[6]);
+}
+
+// Scratch operands never alias and always span a whole block, so the
+// compiler vectorizes this without overlap checks or a remainder loop. Past
+// the end of a short last block the lanes hold stale values and are never
+// stored.
+template <typename T, typename Op>
+void combine_block(T *__restrict x, const T *__restrict y, Op op)
+{
+    for (size_t j = 0; j < BLOCKBYTES / sizeof(T); j++)
+        x[j] = op(x[j], y[j]);
+}
+
+template <typename T>
+Expression<T>::Expression(std::span<const T> data, const Factors &from)
+    : unit{coherent_unit(from)}, size{data.size()}, sized{true}, depth{1}
+{
+    ConversionPlan plan{from, unit};
+    steps.push_back(Step{LazyOp::input, data.data(), static_cast<T>(plan.get_scale()), static_cast<T>(plan.get_shift())});
+}
+
+template <typename T>
+Expression<T> Expression<T>::constant(T value)
+{
+    Expression e{};
+    e.depth = 1;
+    e.steps.push_back(Step{LazyOp::constant, nullptr, 0, value});
+    return e;
+}
+
+// Steps are kept in postfix order, so appending the right operand's steps
+// and then the operation evaluates both operands before combining them.
+template <typename T>
+Expression<T> Expression<T>::combine(LazyOp op, const Expression &o, Factors result) const
+{
+    if (sized && o.sized && size != o.size)
+        throw ConversionError();
+    Expression e{};
+    e.steps.reserve(steps.size() + o.steps.size() + 1);
+    e.steps = steps;
+    e.steps.insert(e.steps.end(), o.steps.begin(), o.steps.end());
+    e.steps.push_back(Step{op, nullptr, 0, 0});
+    e.unit = std::move(result);
+    e.sized = sized || o.sized;
+    e.size = sized ? size : o.size;
+    e.depth = std::max(depth, o.depth + 1);
+    return e;
+}
+
+template <typename T>
+Expression<T> Expression<T>::operator+(const Expression &o) const
+{
+    if (!unit.same_dimension(o.unit))
+        throw FactorsError();
+    return combine(LazyOp::add, o, unit);
+}
+
+template <typename T>
+Expression<T> Expression<T>::operator-(const Expression &o) const
+{
+    if (!unit.same_dimension(o.unit))
+        throw FactorsError();
+    return combine(LazyOp::subtract, o, unit);
+}
+
+template <typename T>
+Expression<T> Expression<T>::operator*(const Expression &o) const
+{
+    return combine(LazyOp::multiply, o, unit * o.unit);
+}
+
+template <typename T>
+Expression<T> Expression<T>::operator/(const Expression &o) const
+{
+    return combine(LazyOp::divide, o, unit / o.unit);
+}
+
+// The power step keeps its exponent in scale.
+template <typename T>
+Expression<T> Expression<T>::pow(const Fraction &exponent) const
+{
+    Factors result{unit};
+    if (!result.try_pow(Factors(exponent, 0, 0, 0, 0, 0, 0, 0, 0)))
+        throw FactorsError();
+    Expression e{*this};
+    e.steps.push_back(Step{LazyOp::power, nullptr, static_cast<T>(exponent), 0});
+    e.unit = std::move(result);
+    return e;
+}
+
+template <typename T>
+void Expression<T>::run(T *out, size_t start, size_t end, T scale, T shift) const
+{
+    const size_t block{BLOCKBYTES / sizeof(T)};
+    std::vector<T> stack(depth * block);
+    for (size_t i = start; i < end; i += block)
+    {
+        size_t n{std::min(block, end - i)};
+        T *top{stack.data()};
+        for (const Step &step : steps)
+        {
+            switch (step.op)
+            {
+            case LazyOp::input:
+                affine(std::span<const T>(step.data + i, n), std::span<T>(top, n), step.scale, step.shift);
+                top += block;
+                break;
+            case LazyOp::constant:
+                std::fill_n(top, n, step.shift);
+                top += block;
+                break;
+            case LazyOp::add:
+                combine_block(top - 2 * block, top - block, [](T x, T y) { return x + y; });
+                top -= block;
+                break;
+            case LazyOp::subtract:
+                combine_block(top - 2 * block, top - block, [](T x, T y) { return x - y; });
+                top -= block;
+                break;
+            case LazyOp::multiply:
+                combine_block(top - 2 * block, top - block, [](T x, T y) { return x * y; });
+                top -= block;
+                break;
+            case LazyOp::divide:
+                combine_block(top - 2 * block, top - block, [](T x, T y) { return x / y; });
+                top -= block;
+                break;
+            case LazyOp::power:
+                for (T *x = top - block; x < top - block + n; x++)
+                    *x = std::pow(*x, step.scale);
+                break;
+            }
+        }
+        affine(std::span<const T>(stack.data(), n), std::span<T>(out + i, n), scale, shift);
+    }
+}
+
+template <typename T>
+void Expression<T>::evaluate(std::span<T> out) const
+{
+    if (sized && out.size() != size)
+        throw ConversionError();
+    run(out.data(), 0, out.size(), 1, 0);
+}
+
+template <typename T>
+void Expression<T>::evaluate(std::span<T> out, const Factors &to) const
+{
+    if (sized && out.size() != size)
+        throw ConversionError();
+    ConversionPlan plan{unit, to};
+    run(out.data(), 0, out.size(), static_cast<T>(plan.get_scale()), static_cast<T>(plan.get_shift()));
+}
+
+// Chunks after the first start on a cache line of the output, as in affine.
+template <typename T>
+void Expression<T>::evaluate(std::span<T> out, const Factors &to, const Executor &executor) const
+{
+    size_t n{out.size()};
+    if (n * sizeof(T) < PARALLELBYTES)
+        return evaluate(out, to);
+    if (sized && n != size)
+        throw ConversionError();
+    ConversionPlan plan{unit, to};
+    T scale{static_cast<T>(plan.get_scale())};
+    T shift{static_cast<T>(plan.get_shift())};
+    size_t chunk{CHUNKBYTES / sizeof(T)};
+    size_t head{(LINEBYTES - reinterpret_cast<uintptr_t>(out.data()) % LINEBYTES) % LINEBYTES / sizeof(T)};
+    size_t nchunks{(n - head + chunk - 1) / chunk};
+    executor(nchunks, [&](size_t i)
+             {
+                 size_t start{i == 0 ? 0 : head + i * chunk};
+                 size_t end{std::min(n, head + (i + 1) * chunk)};
+                 run(out.data(), start, end, scale, shift); });
+}
+
+template class Expression<float>;
+template class Expression<double>;
@@ -0,0 +1,67 @@
+#ifndef LAZY_H
+#define LAZY_H
+#include <cstddef>
+#include <span>
+#include <vector>
+#include "convert.h"
+#include "parser.h"
+#include "threadpool.h"
+
+enum class LazyOp
+{
+    input,
+    constant,
+    add,
+    subtract,
+    multiply,
+    divide,
+    power
+};
+
+// A deferred chain of unit-aware array operations, e.g.
+//   (Expression<double>(a, mm) + Expression<double>(b, in) * 2.0).evaluate(out, m)
+// The result unit is worked out with Factors arithmetic as the expression
+// is built; evaluate then makes one pass over the inputs in blocks small
+// enough to stay in L1, applying every input's conversion to coherent SI
+// units, the operations and the conversion to the requested unit per block.
+template <typename T>
+class Expression
+{
+private:
+    struct Step
+    {
+        LazyOp op;
+        const T *data;
+        T scale;
+        T shift;
+    };
+    std::vector<Step> steps{};
+    Factors unit{};
+    size_t size{0};
+    bool sized{false};
+    size_t depth{0};
+    Expression() = default;
+    Expression combine(LazyOp, const Expression &, Factors) const;
+    void run(T *out, size_t start, size_t end, T scale, T shift) const;
+
+public:
+    Expression(std::span<const T> data, const Factors &unit);
+    static Expression constant(T value);
+    const Factors &get_unit() const { return unit; }
+    size_t get_size() const { return size; }
+    Expression operator+(const Expression &) const;
+    Expression operator-(const Expression &) const;
+    Expression operator*(const Expression &) const;
+    Expression operator/(const Expression &) const;
+    Expression operator*(T x) const { return *this * constant(x); }
+    Expression operator/(T x) const { return *this / constant(x); }
+    Expression pow(const Fraction &) const;
+    void evaluate(std::span<T> out) const;
+    void evaluate(std::span<T> out, const Factors &to) const;
+    void evaluate(std::span<T> out, const Factors &to, const Executor &) const;
+    void evaluate(std::span<T> out, const Factors &to, ThreadPool &pool) const { evaluate(out, to, pool.executor()); }
+};
+
+template <typename T>
+Expression<T> operator*(T x, const Expression<T> &e) { return Expression<T>::constant(x) * e; }
+#endif // LAZY_H
@@ -1 +1,8 @@
-"""nubivis"""
+"""nubivis - compute everywhere with units"""
+try:
+    from nubivis.parser import Unit, add, subtract, multiply, divide, power, convert
+except ImportError:
+    # The C extension is not built; nubivis.prototype still imports.
+    __all__ = []
+else:
+    __all__ = ["Unit", "add", "subtract", "multiply", "divide", "power", "convert"]
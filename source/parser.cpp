@@ -3,152 +3,29 @@
 #include <string>
 #include <sstream>
 #include <cstring>
-#include <map>
+#include <cfloat>
 #include <cmath>
 #include <cctype>
 #include <iostream>
+#include <numeric>
+#include "grammar.h"
 #include "parser.h"
+#include "registry.h"
+#include "serialize.h"
+#include "stats.h"
+#include "threadpool.h"
+#include "trie.h"
 
-using std::map;
 using std::string;
 using std::vector;
 
-const int64_t LENMAXINT{2};
-const int64_t LENMAXSTR{128};
-
-map<string, Factors> SIUNITS{
-    {"m", Factors(1, 0, 1, 0, 0, 0, 0, 0, 0)},
-    {"kg", Factors(1, 0, 0, 1, 0, 0, 0, 0, 0)},
-    {"g", Factors(Fraction(1, 1000), 0, 0, 1, 0, 0, 0, 0, 0)},
-    {"s", Factors(1, 0, 0, 0, 1, 0, 0, 0, 0)},
-    {"A", Factors(1, 0, 0, 0, 0, 1, 0, 0, 0)},
-    {"K", Factors(1, 0, 0, 0, 0, 0, 1, 0, 0)},
-    {"mol", Factors(1, 0, 0, 0, 0, 0, 0, 1, 0)},
-    {"cd", Factors(1, 0, 0, 0, 0, 0, 0, 0, 1)},
-    {"rad", Factors()},
-    {"sr", Factors()},
-    {"Hz", Factors(1, 0, 0, 0, -1, 0, 0, 0, 0)},
-    {"N", Factors(1, 0, 1, 1, -2, 0, 0, 0, 0)},
-    {"Pa", Factors(1, 0, -1, 1, -2, 0, 0, 0, 0)},
-    {"J", Factors(1, 0, 2, 1, -2, 0, 0, 0, 0)},
-    {"W", Factors(1, 0, 2, 1, -3, 0, 0, 0, 0)},
-    {"C", Factors(1, 0, 0, 0, 1, 1, 0, 0, 0)},
-    {"V", Factors(1, 0, 2, 1, -3, -1, 0, 0, 0)},
-    {"F", Factors(1, 0, -2, -1, 4, 2, 0, 0, 0)},
-    {"Ω", Factors(1, 0, 2, 1, -3, -2, 0, 0, 0)},
-    {"S", Factors(1, 0, -2, -1, -2, -1, 0, 0, 0)},
-    {"Wb", Factors(1, 0, 2, 1, -2, -1, 0, 0, 0)},
-    {"T", Factors(1, 0, 0, 1, -2, -1, 0, 0, 0)},
-    {"H", Factors(1, 0, 2, 1, -2, -2, 0, 0, 0)},
-    {"degC", Factors(1, Fraction(27315, 100), 0, 0, 0, 0, 1, 0, 0)},
-    {"lm", Factors(1, 0, 0, 0, 0, 0, 0, 0, 1)},
-    {"lx", Factors(1, 0, -2, 0, 0, 0, 0, 0, 1)},
-    {"Bq", Factors(1, 0, 0, 0, -1, 0, 0, 0, 0)},
-    {"Gy", Factors(1, 0, 2, 0, -2, 0, 0, 0, 0)},
-    {"Sv", Factors(1, 0, 2, 0, -2, 0, 0, 0, 0)},
-    {"kat", Factors(1, 0, 0, 0, -1, 0, 0, 1, 0)},
-    {"L", Factors(Fraction(1, 1000), 0, 3, 0, 0, 0, 0, 0, 0)},
-};
-
-map<string, Factors> NONSIUNITS{
-    {"Å", Factors(Fraction(1, 10000000000), 1, 0, 0, 0, 0, 0, 0, 0)},
-    {"ua", Factors(1.495979e11, 0, 1, 0, 0, 0, 0, 0, 0)},
-    {"ch", Factors(2.011684e1, 0, 1, 0, 0, 0, 0, 0, 0)},
-    {"fathom", Factors(1.828804, 0, 1, 0, 0, 0, 0, 0, 0)},
-    {"fermi", Factors(Fraction(1, 1000000000000000), 0, 1, 0, 0, 0, 0, 0, 0)},
-    {"ft", Factors(3.048e-1, 0, 1, 0, 0, 0, 0, 0, 0)},
-    {"in", Factors(2.54e-2, 0, 1, 0, 0, 0, 0, 0, 0)},
-    {"µ", Factors(Fraction(1, 1000000), 0, 1, 0, 0, 0, 0, 0, 0)},
-    {"mil", Factors(Fraction(254, 10000000), 0, 1, 0, 0, 0, 0, 0, 0)},
-    {"mi", Factors(1.609344e3, 0, 1, 0, 0, 0, 0, 0, 0)},
-    {"yd", Factors(9.144e-1, 0, 1, 0, 0, 0, 0, 0, 0)},
-    {"oz", Factors(2.834952e-2, 0, 0, 1, 0, 0, 0, 0, 0)},
-    {"lb", Factors(4.535924e-1, 0, 0, 1, 0, 0, 0, 0, 0)},
-    {"d", Factors(8.64e4, 0, 0, 0, 1, 0, 0, 0, 0)},
-    {"h", Factors(3.6e3, 0, 0, 0, 1, 0, 0, 0, 0)},
-    {"min", Factors(60, 0, 0, 0, 1, 0, 0, 0, 0)},
-    {"degF", Factors(Fraction(10, 18), 459.67, 0, 0, 0, 0, 1, 0, 0)},
-    {"degR", Factors(Fraction(10, 18), 0, 0, 0, 0, 0, 1, 0, 0)},
-    {"BTU", Factors(1.05587e3, 0, 2, 1, -2, 0, 0, 0, 0)},
-    {"cal", Factors(4.19002, 0, 2, 1, -2, 0, 0, 0, 0)},
-    {"eV", Factors(1.602176e-19, 0, 2, 1, -2, 0, 0, 0, 0)},
-    {"lbf", Factors(4.448222, 0, 1, 1, -2, 0, 0, 0, 0)},
-    {"horsepower", Factors(7.46e2, 0, 2, 1, -3, 0, 0, 0, 0)},
-    {"atm", Factors(1.01325e5, 0, -1, 1, -2, 0, 0, 0, 0)},
-    {"bar", Factors(Fraction(100000, 1), 0, -1, 1, -2, 0, 0, 0, 0)},
-    {"inHg", Factors(3.386389e3, 0, -1, 1, -2, 0, 0, 0, 0)},
-    {"psi", Factors(6.894757, 0, -1, 1, -2, 0, 0, 0, 0)},
-    {"torr", Factors(1.333224e2, 0, -1, 1, -2, 0, 0, 0, 0)},
-    {"rad", Factors(1e-2, 0, 2, 0, -2, 0, 0, 0, 0)},
-    {"rem", Factors(1e-2, 0, 2, 0, -2, 0, 0, 0, 0)},
-    {"gal", Factors(3.785412e-3, 0, 3, 0, 0, 0, 0, 0, 0)},
-};
-
-map<string, Fraction> PREFIXES{
-    {"P", Fraction(1000000000000000)},
-    {"T", Fraction(1000000000000)},
-    {"G", Fraction(1000000000)},
-    {"M", Fraction(1000000)},
-    {"k", Fraction(1000)},
-    {"h", Fraction(100)},
-    {"da", Fraction(10)},
-    {"d", Fraction(1, 10)},
-    {"c", Fraction(1, 100)},
-    {"m", Fraction(1, 1000)},
-    {"µ", Fraction(1, 1000000)},
-    {"n", Fraction(1, 1000000000)},
-    {"p", Fraction(1, 1000000000000)},
-    {"f", Fraction(1, 1000000000000000)},
-};
-
-const vector<string> NUMBERS{"0", "1", "2", "3", "4", "5", "6", "7", "8", "9"};
-const vector<string> OPERATORS{"-", "+", "*", "/", "**", "(", ")"};
-const vector<string> LETTERS{
-    "a",
-    "A",
-    "B",
-    "b",
-    "c",
-    "C",
-    "d",
-    "e",
-    "E",
-    "f",
-    "F",
-    "g",
-    "G",
-    "h",
-    "H",
-    "i",
-    "k",
-    "K",
-    "l",
-    "L",
-    "m",
-    "M",
-    "µ",
-    "n",
-    "N",
-    "o",
-    "p",
-    "P",
-    "q",
-    "r",
-    "S",
-    "s",
-    "t",
-    "T",
-    "v",
-    "V",
-    "W",
-    "x",
-    "y",
-    "Y",
-    "z",
-    "Z",
-    "Ω",
-};
-vector<string> simpletokens{};
+const size_t BATCHCHUNK{64};
+const size_t BATCHPARALLEL{512};
+const unsigned POWMAXBITS{4096};
+// Products and quotients are held to the same bound as powers, so a long
+// chain of them cannot make every further operation slower.
+const size_t MULTIPLIERMAXBITS{POWMAXBITS};
+const unsigned ROOTMAXDEGREE{64};
 
 bool Token::startswith(const char *s)
 {
@@ -164,140 +41,127 @@ bool Token::endswith(const char *s)
     return (value.substr(value.size() - len) == s);
 }
 
-bool Token::isdecimal()
-{
-    for (auto ch : value)
-    {
-        if (std::isdigit(ch))
-            continue;
-        return false;
-    }
-    return true;
-}
-
 std::ostream &operator<<(std::ostream &os, const Token &t) { return os << t.value; }
 
-Token TokenStream::get_numbers(Token t)
+const Fraction zero{0};
+
+Fraction to_fraction(const Scalar &x)
 {
-    if (expression.size() == 0)
-        return t;
-    string ch{expression[0]};
-    expression = expression.substr(1);
-    if (std::find(NUMBERS.begin(), NUMBERS.end(), ch) == NUMBERS.end())
-    {
-        putback(ch);
-        return t;
-    }
-    t += Token(ch);
-    if (t.size() > LENMAXINT)
-        throw TokenError();
-    return get_numbers(t);
+    if (x.exact())
+        return Fraction(x.num, x.den);
+    return Fraction(x.value);
 }
 
-Token TokenStream::get_letters(Token t)
+Factors::Factors(const Unit &u)
+    : multiplier{to_fraction(u.multiplier)},
+      offset{to_fraction(u.offset)},
+      m{u.m},
+      kg{u.kg},
+      s{u.s},
+      A{u.A},
+      K{u.K},
+      mol{u.mol},
+      cd{u.cd},
+      signature{unit_signature(u)}
 {
-    if (expression.size() == 0)
-        return t;
-    string ch{expression[0]};
-    expression = expression.substr(1);
-    if (std::find(LETTERS.begin(), LETTERS.end(), ch) == LETTERS.end())
-    {
-        putback(ch);
-        return t;
-    }
-    t += Token(ch);
-    if (t.size() > LENMAXSTR)
-        throw TokenError();
-    return get_letters(t);
 }
 
-const vector<string> ops{"-", "+", "/", "(", ")"};
+Factors::Factors(const Unit &base, const Prefix &prefix) : Factors{base}
+{
+    set_multiplier(multiplier * to_fraction(prefix.multiplier));
+}
 
-const Token empty_token{""};
-const string op_star{"*"};
+Factors::Factors(Fraction multiplier, Fraction offset, Fraction m, Fraction kg, Fraction s, Fraction A, Fraction K, Fraction mol, Fraction cd)
+    : multiplier{std::move(multiplier)},
+      offset{std::move(offset)},
+      m{std::move(m)},
+      kg{std::move(kg)},
+      s{std::move(s)},
+      A{std::move(A)},
+      K{std::move(K)},
+      mol{std::move(mol)},
+      cd{std::move(cd)}
+{
+    update_signature();
+}
 
-Token TokenStream::get()
+void Factors::update_signature()
 {
-    if (expression.size() == 0)
-        return empty_token;
-    string ch{expression[0]};
-    expression = expression.substr(1);
-    if (find(ops.begin(), ops.end(), ch) != ops.end())
-        return Token(ch);
-    if (ch == op_star)
+    std::array<int32_t, 7> twelfths{};
+    std::array<Fraction, 7> d{get_dimension()};
+    for (size_t i = 0; i < 7; i++)
     {
-        if (expression[0] == '*')
+        Fraction x{d[i] * SIGNATURESCALE};
+        if (!x.is_integer() || x < SIGNATUREMIN || x > SIGNATUREMAX)
         {
-            ch += op_star;
-            expression = expression.substr(1);
+            signature = SIGNATUREINEXACT;
+            return;
         }
-        return Token(ch);
+        twelfths[i] = static_cast<int32_t>(x.get_numerator());
     }
-    if (std::find(NUMBERS.begin(), NUMBERS.end(), ch) != NUMBERS.end())
-        return get_numbers(Token(ch));
-    if (std::find(LETTERS.begin(), LETTERS.end(), ch) != LETTERS.end())
-        return get_letters(Token(ch));
-    throw TokenError();
+    signature = pack_signature(twelfths);
 }
 
-const Fraction zero{0};
+bool Factors::same_dimension(const Factors &other) const
+{
+    if (signature != SIGNATUREINEXACT && other.signature != SIGNATUREINEXACT)
+        return signature == other.signature;
+    return m == other.m && kg == other.kg && s == other.s && A == other.A && K == other.K && mol == other.mol && cd == other.cd;
+}
+
+// Irrational multipliers compare by their exact root and sign, since equal
+// roots reached in different ways may have different approximations.
+bool Factors::operator==(const Factors &other) const
+{
+    if (degree != other.degree || offset != other.offset || !same_dimension(other))
+        return false;
+    if (degree > 1)
+        return radicand == other.radicand && (multiplier < 0) == (other.multiplier < 0);
+    return multiplier == other.multiplier;
+}
+
+void Factors::set_multiplier(Fraction x)
+{
+    multiplier = std::move(x);
+    radicand = 1;
+    degree = 1;
+}
+
+void Factors::set_root(Fraction r, uint8_t d)
+{
+    radicand = d > 1 ? std::move(r) : Fraction(1);
+    degree = d;
+}
 
-Factors Factors::operator*(Factors other)
+Factors Factors::operator*(const Factors &other) const
 {
     if (offset != zero && other.offset != zero)
         throw FactorsError();
-    Factors res{};
-    res.multiplier = multiplier * other.multiplier;
-    res.m = m + other.m;
-    res.kg = kg + other.kg;
-    res.s = s + other.s;
-    res.A = A + other.A;
-    res.mol = mol + other.mol;
-    res.cd = cd + other.cd;
-    return res;
+    Factors res{*this};
+    res.offset = zero;
+    return res *= other;
 }
 
-Factors &Factors::operator*=(Factors other)
+Factors &Factors::operator*=(const Factors &other)
 {
-    if (offset != 0 && other.offset != zero)
+    if (!try_multiply(other))
         throw FactorsError();
-    multiplier *= other.multiplier;
-    m += other.m;
-    kg += other.kg;
-    s += other.s;
-    A += other.A;
-    K += other.K;
-    mol += other.mol;
-    cd += other.cd;
     return *this;
 }
 
-Factors Factors::operator/(Factors other)
+Factors Factors::operator/(const Factors &other) const
 {
     if (offset != zero && other.offset != zero)
         throw FactorsError();
-    Factors res{};
-    res.multiplier = multiplier / other.multiplier;
-    res.m = m - other.m;
-    res.kg = kg - other.kg;
-    res.s = s - other.s;
-    res.A = A - other.A;
-    res.mol = mol - other.mol;
-    res.cd = cd - other.cd;
-    return res;
+    Factors res{*this};
+    res.offset = zero;
+    return res /= other;
 }
 
-Factors &Factors::operator/=(Factors other)
+Factors &Factors::operator/=(const Factors &other)
 {
-    if (offset != zero && other.offset != zero)
+    if (!try_divide(other))
         throw FactorsError();
-    multiplier = multiplier / other.multiplier;
-    m -= other.m;
-    kg -= other.kg;
-    s -= other.s;
-    A -= other.A;
-    mol -= other.mol;
-    cd -= other.cd;
     return *this;
 }
 
@@ -312,21 +176,383 @@ Factors Factors::operator+()
     return *this;
 }
 
-Factors &Factors::pow(Factors f)
+bool exact_root(const BigInteger &x, unsigned n, BigInteger &root)
 {
-    if (offset != zero)
+    if (x < 2)
+    {
+        root = x;
+        return true;
+    }
+    BigInteger r{BigInteger(1) << (msb(x) / n + 1)};
+    while (true)
+    {
+        BigInteger next{((n - 1) * r + x / boost::multiprecision::pow(r, n - 1)) / n};
+        if (next >= r)
+            break;
+        r = next;
+    }
+    root = r;
+    return boost::multiprecision::pow(r, n) == x;
+}
+
+bool checked_pow(uint64_t x, unsigned n, uint64_t &result)
+{
+    uint64_t r{1};
+    for (unsigned i = 0; i < n; i++)
+        if (__builtin_mul_overflow(r, x, &r))
+            return false;
+    result = r;
+    return true;
+}
+
+// The rounded floating-point root is within one of the integer root for
+// any 64-bit x.
+bool exact_root(uint64_t x, unsigned n, uint64_t &root)
+{
+    if (x < 2 || n == 1)
+    {
+        root = x;
+        return true;
+    }
+    uint64_t r{static_cast<uint64_t>(std::llround(std::pow(static_cast<double>(x), 1.0 / n)))};
+    for (uint64_t c : {r - 1, r, r + 1})
+    {
+        uint64_t p{};
+        if (c > 0 && checked_pow(c, n, p) && p == x)
+        {
+            root = c;
+            return true;
+        }
+    }
+    return false;
+}
+
+Fraction power(Fraction x, unsigned n)
+{
+    Fraction r{1};
+    while (n > 0)
+    {
+        if (n & 1)
+            r *= x;
+        n >>= 1;
+        if (n > 0)
+            x *= x;
+    }
+    return r;
+}
+
+unsigned bit_length(uint64_t x)
+{
+    return 64 - __builtin_clzll(x);
+}
+
+Fraction approximate_big(double x)
+{
+    BigInteger p0{0}, q0{1}, p1{1}, q1{0};
+    double y{std::abs(x)};
+    for (int i = 0; i < 64; i++)
+    {
+        double a{std::floor(y)};
+        if (!std::isfinite(a))
+            break;
+        BigInteger ai{a};
+        BigInteger p2{ai * p1 + p0};
+        BigInteger q2{ai * q1 + q0};
+        p0 = p1;
+        q0 = q1;
+        p1 = p2;
+        q1 = q2;
+        if (std::abs(static_cast<double>(BigFraction(p1, q1)) - std::abs(x)) <= std::abs(x) * DBL_EPSILON || y == a)
+            break;
+        y = 1 / (y - a);
+    }
+    return Fraction(x < 0 ? BigFraction(-p1, q1) : BigFraction(p1, q1));
+}
+
+// Continued fraction convergents, in int64 until a term overflows. A
+// remainder so small that its reciprocal is infinite ends the expansion.
+Fraction approximate(double x)
+{
+    int64_t p0{0}, q0{1}, p1{1}, q1{0};
+    double y{std::abs(x)};
+    for (int i = 0; i < 64; i++)
+    {
+        double a{std::floor(y)};
+        if (!std::isfinite(a))
+            break;
+        if (a >= static_cast<double>(INT64_MAX))
+            return approximate_big(x);
+        int64_t ai{static_cast<int64_t>(a)};
+        int64_t p2{}, q2{};
+        if (__builtin_mul_overflow(ai, p1, &p2) || __builtin_add_overflow(p2, p0, &p2) ||
+            __builtin_mul_overflow(ai, q1, &q2) || __builtin_add_overflow(q2, q0, &q2) ||
+            p2 == INT64_MIN)
+            return approximate_big(x);
+        p0 = p1;
+        q0 = q1;
+        p1 = p2;
+        q1 = q2;
+        if (std::abs(static_cast<double>(Fraction(p1, q1)) - std::abs(x)) <= std::abs(x) * DBL_EPSILON || y == a)
+            break;
+        y = 1 / (y - a);
+    }
+    return x < 0 ? Fraction(-p1, q1) : Fraction(p1, q1);
+}
+
+// A subnormal power has no convergent other than 0 within reach of the
+// expansion, and a zero multiplier would poison later divisions.
+bool approximate_pow(double x, double y, bool negative, Fraction &result)
+{
+    double r{std::pow(x, y)};
+    if (!std::isfinite(r) || r == 0)
+        return false;
+    Fraction a{approximate(negative ? -r : r)};
+    if (a == 0)
+        return false;
+    result = std::move(a);
+    return true;
+}
+
+bool big_rational_pow(const BigFraction &x, const BigFraction &y, Fraction &result, bool &exact)
+{
+    const BigInteger p{numerator(y)};
+    const BigInteger q{denominator(y)};
+    if (x < 0 && q % 2 == 0)
+        return false;
+    bool negative{x < 0 && p % 2 != 0};
+    BigInteger num{abs(numerator(x))};
+    BigInteger den{denominator(x)};
+    BigInteger rn{}, rd{};
+    if (q <= ROOTMAXDEGREE && abs(p) <= POWMAXBITS &&
+        exact_root(num, static_cast<unsigned>(q), rn) && exact_root(den, static_cast<unsigned>(q), rd))
+    {
+        unsigned n{static_cast<unsigned>(abs(p))};
+        if ((msb(rn) + 1) * n <= POWMAXBITS && (msb(rd) + 1) * n <= POWMAXBITS)
+        {
+            BigFraction r(boost::multiprecision::pow(rn, n), boost::multiprecision::pow(rd, n));
+            if (p < 0)
+                r = 1 / r;
+            result = Fraction(negative ? BigFraction(-r) : r);
+            exact = true;
+            return true;
+        }
+    }
+    exact = false;
+    return approximate_pow(static_cast<double>(abs(x)), static_cast<double>(y), negative, result);
+}
+
+// Exact when the root of numerator and denominator is an integer and the
+// power stays within POWMAXBITS, otherwise the nearest convergent of the
+// floating-point power.
+bool rational_pow(const Fraction &x, const Fraction &y, Fraction &result, bool &exact)
+{
+    exact = true;
+    if (x == 0)
+    {
+        if (y <= 0)
+            return false;
+        result = 0;
+        return true;
+    }
+    if (x.is_big() || y.is_big())
+        return big_rational_pow(x.to_big(), y.to_big(), result, exact);
+    int64_t p{y.get_numerator()};
+    int64_t q{y.get_denominator()};
+    if (x < 0 && q % 2 == 0)
+        return false;
+    bool negative{x < 0 && p % 2 != 0};
+    uint64_t num{static_cast<uint64_t>(std::abs(x.get_numerator()))};
+    uint64_t den{static_cast<uint64_t>(x.get_denominator())};
+    uint64_t rn{}, rd{};
+    uint64_t n{static_cast<uint64_t>(std::abs(p))};
+    if (q <= ROOTMAXDEGREE && n <= POWMAXBITS &&
+        exact_root(num, static_cast<unsigned>(q), rn) && exact_root(den, static_cast<unsigned>(q), rd) &&
+        bit_length(rn) * n <= POWMAXBITS && bit_length(rd) * n <= POWMAXBITS)
+    {
+        Fraction r{power(Fraction(rn), static_cast<unsigned>(n)) / power(Fraction(rd), static_cast<unsigned>(n))};
+        if (p < 0)
+            r = 1 / r;
+        result = negative ? -r : r;
+        return true;
+    }
+    exact = false;
+    return approximate_pow(static_cast<double>(abs(x)), static_cast<double>(y), negative, result);
+}
+
+// Root of a positive x when numerator and denominator both have one.
+bool fraction_root(const Fraction &x, unsigned n, Fraction &root)
+{
+    if (x.is_big())
+    {
+        BigFraction b{x.to_big()};
+        BigInteger rn{}, rd{};
+        if (!exact_root(BigInteger(numerator(b)), n, rn) || !exact_root(BigInteger(denominator(b)), n, rd))
+            return false;
+        root = Fraction(BigFraction(rn, rd));
+        return true;
+    }
+    uint64_t rn{}, rd{};
+    if (!exact_root(static_cast<uint64_t>(x.get_numerator()), n, rn) || !exact_root(static_cast<uint64_t>(x.get_denominator()), n, rd))
+        return false;
+    root = Fraction(static_cast<int64_t>(rn), static_cast<int64_t>(rd));
+    return true;
+}
+
+// Takes every exact root out of x**(1/n), which leaves n at the smallest
+// degree for the value and so makes the form unique.
+void reduce_root(Fraction &x, unsigned &n)
+{
+    Fraction r{};
+    for (unsigned d = 2; d <= n; d++)
+        while (n % d == 0 && fraction_root(x, d, r))
+        {
+            x = r;
+            n /= d;
+        }
+}
+
+// (r**(1/n))**y as radicand**(1/degree), while the degree stays within
+// ROOTMAXDEGREE and the power within POWMAXBITS.
+bool root_pow(const Fraction &r, unsigned n, const Fraction &y, Fraction &radicand, unsigned &degree)
+{
+    if (y.is_big())
+        return false;
+    uint64_t a{static_cast<uint64_t>(std::abs(y.get_numerator()))};
+    uint64_t q{static_cast<uint64_t>(y.get_denominator())};
+    if (q > ROOTMAXDEGREE || n * q > ROOTMAXDEGREE || a > POWMAXBITS)
+        return false;
+    Fraction x{r};
+    unsigned k{static_cast<unsigned>(n * q)};
+    reduce_root(x, k);
+    if (x.bits() * a > POWMAXBITS)
+        return false;
+    x = power(x, static_cast<unsigned>(a));
+    if (y < 0)
+        x = 1 / x;
+    reduce_root(x, k);
+    radicand = std::move(x);
+    degree = k;
+    return true;
+}
+
+// r**(1/a) times or divided by s**(1/b) as radicand**(1/degree) over the
+// common degree.
+bool root_product(const Fraction &r, unsigned a, const Fraction &s, unsigned b, bool divide, Fraction &radicand, unsigned &degree)
+{
+    unsigned n{std::lcm(a, b)};
+    if (n > ROOTMAXDEGREE || r.bits() * (n / a) > MULTIPLIERMAXBITS || s.bits() * (n / b) > MULTIPLIERMAXBITS)
+        return false;
+    Fraction x{power(r, n / a)};
+    Fraction z{power(s, n / b)};
+    if (divide)
+        x /= z;
+    else
+        x *= z;
+    if (x.bits() > MULTIPLIERMAXBITS)
+        return false;
+    reduce_root(x, n);
+    radicand = std::move(x);
+    degree = n;
+    return true;
+}
+
+bool Factors::try_multiply(const Factors &other)
+{
+    return combine(other, false);
+}
+
+bool Factors::try_divide(const Factors &other)
+{
+    return combine(other, true);
+}
+
+// The approximations multiply as before; when either side is irrational the
+// exact roots are combined too, and become the exact multiplier again if
+// the result turns out rational.
+bool Factors::combine(const Factors &other, bool divide)
+{
+    if ((offset != zero && other.offset != zero) || (divide && other.multiplier == zero))
+        return false;
+    Fraction x{divide ? multiplier / other.multiplier : multiplier * other.multiplier};
+    if (x.bits() > MULTIPLIERMAXBITS)
+        return false;
+    uint8_t d{degree == 0 || other.degree == 0 ? uint8_t{0} : uint8_t{1}};
+    Fraction r{1};
+    unsigned n{1};
+    if (d == 1 && (degree > 1 || other.degree > 1))
+    {
+        if (!root_product(root_magnitude(), root_degree(), other.root_magnitude(), other.root_degree(), divide, r, n))
+            d = 0;
+        else if (n == 1)
+            x = x < 0 ? -r : r;
+        else
+            d = static_cast<uint8_t>(n);
+    }
+    multiplier = std::move(x);
+    set_root(std::move(r), d);
+    if (divide)
+    {
+        m -= other.m;
+        kg -= other.kg;
+        s -= other.s;
+        A -= other.A;
+        K -= other.K;
+        mol -= other.mol;
+        cd -= other.cd;
+    }
+    else
+    {
+        m += other.m;
+        kg += other.kg;
+        s += other.s;
+        A += other.A;
+        K += other.K;
+        mol += other.mol;
+        cd += other.cd;
+    }
+    update_signature();
+    return true;
+}
+
+Factors &Factors::pow(const Factors &f)
+{
+    if (!try_pow(f))
         throw FactorsError();
-    Fraction exponent{f.get_multiplier()};
-    double x = static_cast<double>(multiplier);
-    double y = static_cast<double>(exponent);
-    multiplier = Fraction(std::pow(x, y));
+    return *this;
+}
+
+bool Factors::try_pow(const Factors &f)
+{
+    if (offset != zero)
+        return false;
+    const Fraction &exponent{f.multiplier};
+    Fraction x{};
+    bool exact{};
+    if (!rational_pow(multiplier, exponent, x, exact))
+        return false;
+    uint8_t d{degree == 0 ? uint8_t{0} : uint8_t{1}};
+    Fraction r{1};
+    unsigned n{1};
+    if (degree > 1 || (degree == 1 && !exact))
+    {
+        if (!root_pow(root_magnitude(), root_degree(), exponent, r, n))
+            d = 0;
+        else if (n == 1)
+            x = x < 0 ? -r : r;
+        else
+            d = static_cast<uint8_t>(n);
+    }
+    multiplier = std::move(x);
+    set_root(std::move(r), d);
     m *= exponent;
     kg *= exponent;
     s *= exponent;
     A *= exponent;
+    K *= exponent;
     mol *= exponent;
     cd *= exponent;
-    return *this;
+    update_signature();
+    return true;
 }
 
 std::ostream &operator<<(std::ostream &os, const Factors &f)
@@ -354,124 +580,197 @@ std::ostream &operator<<(std::ostream &os, const Factors &f)
     return os << oss.str();
 }
 
-Factors Parser::parse(const std::string &units)
+std::optional<Factors> ParseCache::find(std::string_view units)
 {
-    ts = TokenStream(units);
-    return get_expression();
+    std::lock_guard<std::mutex> lock{mutex};
+    auto it{index.find(units)};
+    if (it == index.end())
+    {
+        misses++;
+        return std::nullopt;
+    }
+    hits++;
+    entries.splice(entries.begin(), entries, it->second);
+    return it->second->second;
 }
 
-Factors Parser::get_expression()
+void ParseCache::insert(std::string_view units, const Factors &f)
 {
-    Factors f{get_term()};
-    Token t{ts.get()};
-    while (true)
-    {
-        if (t == "*")
-        {
-            f *= get_term();
-        }
-        else if (t == "/")
-            f /= get_term();
-        else if (t == "")
-            break;
-        else
-        {
-            ts.putback(t);
-            break;
-        }
-        t = ts.get();
-    }
-    return f;
+    std::lock_guard<std::mutex> lock{mutex};
+    if (capacity == 0 || index.find(units) != index.end())
+        return;
+    entries.emplace_front(string(units), f);
+    index[entries.front().first] = entries.begin();
+    evict();
 }
 
-Factors Parser::get_term()
+// Most recently used first.
+std::vector<std::pair<string, Factors>> ParseCache::contents() const
 {
-    Factors f{get_unit()};
-    Token t{ts.get()};
-    while (true)
-    {
-        if (t == "**")
-            f = f.pow(get_numberterm());
-        else
-        {
-            ts.putback(t);
-            break;
-        }
-        t = ts.get();
-    }
-    return f;
+    std::lock_guard<std::mutex> lock{mutex};
+    return std::vector<std::pair<string, Factors>>(entries.begin(), entries.end());
 }
 
-Factors Parser::get_unit()
+void ParseCache::evict()
 {
-    Token t{ts.get()};
-    Factors f{};
-    if (NONSIUNITS.find(t.str()) != NONSIUNITS.end())
-        return NONSIUNITS[t.str()];
-    if (SIUNITS.find(t.str()) != SIUNITS.end())
-        return SIUNITS[t.str()];
-    size_t prefixlen{1};
-    if (t.startswith("da"))
-        prefixlen = 2;
-    if (PREFIXES.find(t.str().substr(0, prefixlen)) != PREFIXES.end())
-    {
-        f = SIUNITS[t.str().substr(prefixlen)];
-        Fraction multiplier{f.get_multiplier()};
-        multiplier *= PREFIXES[t.str().substr(0, prefixlen)];
-        f.set_multiplier(multiplier);
-        return f;
-    }
-    if (t == "(")
+    while (entries.size() > capacity)
     {
-        f = get_expression();
-        t = ts.get();
-        if (t != ")")
-            throw TokenError();
-        return f;
+        index.erase(entries.back().first);
+        entries.pop_back();
     }
+}
+
+void ParseCache::clear()
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    index.clear();
+    entries.clear();
+    hits = 0;
+    misses = 0;
+}
+
+size_t ParseCache::size() const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return entries.size();
+}
+
+size_t ParseCache::get_capacity() const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return capacity;
+}
+
+void ParseCache::set_capacity(size_t n)
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    capacity = n;
+    evict();
+}
+
+Factors unwrap(const ParseResult &f)
+{
+    if (f)
+        return *f;
+    if (f.error().kind == ParseStatus::factors_error)
+        throw FactorsError();
     throw TokenError();
 }
 
-Factors Parser::get_numberterm(bool inpar)
+Parser::Parser() : registry{&UnitRegistry::shared()}
 {
-    Factors f{get_number()};
-    Token t{ts.get()};
-    while (true)
-    {
-        if (inpar && t == "/")
-            f /= get_number();
-        else if (inpar && t == "*")
-            f *= get_number();
-        else
-        {
-            ts.putback(t);
-            break;
-        }
-        t = ts.get();
-    }
+}
+
+Parser::Parser(size_t cache_capacity) : cache{cache_capacity}, registry{&UnitRegistry::shared()}
+{
+}
+
+Parser::Parser(const UnitRegistry &registry, size_t cache_capacity) : cache{cache_capacity}, registry{&registry}
+{
+}
+
+ParseResult Parser::try_parse_uncached(std::string_view units)
+{
+    return try_parse_uncached(units, UnitRegistry::shared().local());
+}
+
+ParseResult Parser::try_parse_uncached(std::string_view units, const RegistrySnapshot *registry)
+{
+    NUBIVIS_TIME();
+    if (units.size() > LENMAXEXPRESSION)
+        return std::unexpected(ParseError{ParseStatus::too_long, LENMAXEXPRESSION});
+    ParseSession session{};
+    ParseResult f{Grammar<Factors>::parse(units, registry)};
+    if (!f)
+        return f;
+    session.end();
+    Factors result{*f};
+    return result;
+}
+
+Factors Parser::parse_uncached(std::string_view units)
+{
+    return unwrap(try_parse_uncached(units));
+}
+
+// Registrations never change the meaning of an expression that parsed, so
+// a hit needs no registry snapshot and a miss takes the thread's own.
+ParseResult Parser::try_parse(std::string_view units) const
+{
+    std::optional<Factors> cached{cache.find(units)};
+    if (!cached && shared_cache != nullptr && (cached = shared_cache->find(units)))
+        cache.insert(units, *cached);
+    if (cached)
+        return *cached;
+    ParseResult f{try_parse_uncached(units, registry->local())};
+    if (f)
+        cache.insert(units, *f);
     return f;
 }
 
-Factors Parser::get_number()
+Factors Parser::parse(std::string_view units) const
+{
+    return unwrap(try_parse(units));
+}
+
+ParseBatch Parser::parse_many(std::span<const std::string_view> expressions) const
+{
+    return parse_many(expressions, ThreadPool::shared());
+}
+
+ParseBatch Parser::parse_many(std::span<const std::string_view> expressions, ThreadPool &pool) const
 {
-    Factors f{};
-    Token t{ts.get()};
-    if (t == "(")
+    std::shared_ptr<const RegistrySnapshot> snapshot{registry->snapshot()};
+    size_t n{expressions.size()};
+    ParseBatch batch{};
+    batch.factors.resize(n);
+    batch.status.resize(n, ParseStatus::ok);
+    std::unordered_map<std::string_view, size_t> seen{};
+    seen.reserve(n);
+    std::vector<size_t> first(n);
+    std::vector<size_t> pending{};
+    for (size_t i = 0; i < n; i++)
     {
-        f = get_numberterm(true);
-        t = ts.get();
-        if (t != ")")
-            throw TokenError();
-        return f;
+        auto [it, inserted] = seen.try_emplace(expressions[i], i);
+        first[i] = it->second;
+        if (!inserted)
+            continue;
+        std::optional<Factors> cached{cache.find(expressions[i])};
+        if (!cached && shared_cache != nullptr && (cached = shared_cache->find(expressions[i])))
+            cache.insert(expressions[i], *cached);
+        if (cached)
+            batch.factors[i] = *cached;
+        else
+            pending.push_back(i);
     }
-    if (t.isdecimal())
+    auto parse_range = [&](size_t begin, size_t end)
     {
-        f.set_multiplier(Fraction(t.str()));
-        return f;
+        for (size_t k = begin; k < end; k++)
+        {
+            size_t i{pending[k]};
+            ParseResult f{try_parse_uncached(expressions[i], snapshot.get())};
+            if (f)
+                batch.factors[i] = std::move(*f);
+            else
+                batch.status[i] = f.error().kind;
+        }
+    };
+    if (pending.size() < BATCHPARALLEL)
+        parse_range(0, pending.size());
+    else
+        pool.parallel_for((pending.size() + BATCHCHUNK - 1) / BATCHCHUNK, [&](size_t chunk)
+                          { parse_range(chunk * BATCHCHUNK, std::min(pending.size(), (chunk + 1) * BATCHCHUNK)); });
+    for (size_t i : pending)
+    {
+        if (batch.status[i] == ParseStatus::ok)
+            cache.insert(expressions[i], batch.factors[i]);
     }
-    if (t == "-")
-        return (-get_number());
-    if (t == "+")
-        return get_number();
-    throw TokenError();
+    for (size_t i = 0; i < n; i++)
+    {
+        if (first[i] == i)
+            continue;
+        batch.factors[i] = batch.factors[first[i]];
+        batch.status[i] = batch.status[first[i]];
+    }
+    return batch;
 }
@@ -1,12 +1,35 @@
 #ifndef PARSER_H
 #define PARSER_H
+#include <array>
+#include <atomic>
+#include <expected>
 #include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
-#include <boost/multiprecision/cpp_int.hpp>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "arena.h"
+#include "rational.h"
+#include "stats.h"
+#include "tables.h"
 
 using std::string;
 
-typedef boost::multiprecision::cpp_rational Fraction;
+class StringHash
+{
+public:
+    typedef void is_transparent;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+};
+
+class RegistrySnapshot;
+class UnitRegistry;
+class CacheSnapshot;
 
 class TokenError
 {
@@ -20,50 +43,178 @@ public:
     FactorsError() = default;
 };
 
+enum class ParseStatus : uint8_t
+{
+    ok,
+    token_error,
+    unknown_unit,
+    factors_error,
+    too_deep,
+    too_long,
+};
+
+// Bounds on what a single expression may cost: longer input is rejected
+// before tokenizing, and deeper nesting of parentheses or unary signs ends
+// the parse instead of growing the stack.
+const size_t LENMAXEXPRESSION{size_t{1} << 12};
+const size_t DEPTHMAX{128};
+const size_t LENMAXINT{2};
+const size_t LENMAXSTR{128};
+
+class ParseError
+{
+public:
+    ParseStatus kind{ParseStatus::ok};
+    size_t offset{0};
+};
+
 class Token
 {
 private:
-    string value;
+    std::string_view value;
+    size_t start{0};
 
 public:
-    Token(char ch) : value{ch} {};
-    Token(string ch) : value{ch} {};
-    Token operator+(Token other) { return Token(value + other.value); }
-    Token &operator+=(Token other)
-    {
-        value += other.value;
-        return *this;
-    }
-    bool operator==(Token other) { return value == other.value; }
-    bool operator==(string other) { return value == other; }
-    bool operator!=(string other) { return value != other; }
-    size_t size() { return value.size(); }
+    constexpr Token(std::string_view ch, size_t start = 0) : value{ch}, start{start} {};
+    constexpr bool operator==(Token other) { return value == other.value; }
+    constexpr bool operator==(std::string_view other) { return value == other; }
+    constexpr bool operator!=(std::string_view other) { return value != other; }
+    constexpr size_t size() { return value.size(); }
     friend std::ostream &operator<<(std::ostream &, const Token &);
-    string str() { return value; }
+    string str() { return string(value); }
+    constexpr std::string_view view() { return value; }
+    constexpr size_t offset() const { return start; }
     bool startswith(const char *);
     bool endswith(const char *);
-    bool isdecimal();
+    constexpr bool isdecimal()
+    {
+        for (char ch : value)
+            if (ch < '0' || ch > '9')
+                return false;
+        return true;
+    }
 };
 
+// Tokenizes in constant expressions as well, so that the compile time
+// parse of units.h reads the same tokens as a run time one.
 class TokenStream
 {
 private:
-    string expression;
-    Token get_numbers(Token);
-    Token get_letters(Token);
+    std::string_view expression;
+    size_t position{0};
+    Token lookahead{""};
+    bool full{false};
+    std::optional<ParseError> error{};
+    const RegistrySnapshot *registry{nullptr};
+    size_t depth{0};
+
+    constexpr Token get_numbers(size_t start)
+    {
+        while (position < expression.size() && char_class(expression[position]) == CHAR_DIGIT)
+        {
+            position++;
+            if (position - start > LENMAXINT)
+                return fail(start);
+        }
+        return Token(expression.substr(start, position - start), start);
+    }
+    constexpr Token get_letters(size_t start)
+    {
+        while (position < expression.size())
+        {
+            size_t n{letter_length(expression, position)};
+            if (n == 0)
+                break;
+            position += n;
+            if (position - start > LENMAXSTR)
+                return fail(start);
+        }
+        return Token(expression.substr(start, position - start), start);
+    }
+    constexpr Token fail(size_t start)
+    {
+        if (!error)
+            error = ParseError{ParseStatus::token_error, start};
+        position = expression.size();
+        return Token("", start);
+    }
 
 public:
-    TokenStream(string expression) : expression{expression} {};
-    void putback(char ch) { expression = ch + expression; }
-    void putback(string ch) { expression = ch + expression; }
-    void putback(Token t) { expression = t.str() + expression; }
-    Token get();
+    constexpr TokenStream(std::string_view expression, const RegistrySnapshot *registry = nullptr) : expression{expression}, registry{registry} {};
+    constexpr const std::optional<ParseError> &get_error() const { return error; }
+    constexpr const RegistrySnapshot *get_registry() const { return registry; }
+    constexpr void putback(Token t)
+    {
+        lookahead = t;
+        full = true;
+    }
+    constexpr Token get()
+    {
+        if (full)
+        {
+            full = false;
+            return lookahead;
+        }
+        if (position >= expression.size())
+            return Token("", position);
+        if !consteval
+        {
+            NUBIVIS_COUNT(tokens);
+        }
+        size_t start{position};
+        switch (char_class(expression[position]))
+        {
+        case CHAR_OPERATOR:
+            position++;
+            return Token(expression.substr(start, 1), start);
+        case CHAR_STAR:
+            position++;
+            if (position < expression.size() && expression[position] == '*')
+                position++;
+            return Token(expression.substr(start, position - start), start);
+        case CHAR_DIGIT:
+            return get_numbers(start);
+        case CHAR_LETTER:
+        case CHAR_LEAD:
+            if (letter_length(expression, position) != 0)
+                return get_letters(start);
+            break;
+        default:
+            break;
+        }
+        return fail(start);
+    }
+    constexpr size_t get_offset() const { return full ? lookahead.offset() : position; }
+    constexpr size_t get_depth() const { return depth; }
+    friend class Nesting;
+};
+
+// Counts one level of grammar recursion for as long as it is in scope.
+class Nesting
+{
+private:
+    TokenStream &ts;
+
+public:
+    constexpr explicit Nesting(TokenStream &ts) : ts{ts} { ts.depth++; }
+    Nesting(const Nesting &) = delete;
+    Nesting &operator=(const Nesting &) = delete;
+    constexpr ~Nesting() { ts.depth--; }
+    constexpr bool exceeded() const { return ts.depth > DEPTHMAX; }
 };
 
+// A multiplier that a fractional power leaves irrational is kept exactly as
+// radicand**(1/degree), with radicand > 0 and degree as small as possible so
+// that each value has one form; multiplier then holds the sign and a
+// rational approximation for arithmetic on data. degree is 1 for an exact
+// multiplier and 0 for an approximation with no exact form, which only
+// equals itself.
 class Factors
 {
 private:
     Fraction multiplier{1};
+    Fraction radicand{1};
+    uint8_t degree{1};
     Fraction offset{0};
     Fraction m{0};
     Fraction kg{0};
@@ -72,34 +223,103 @@ private:
     Fraction K{0};
     Fraction mol{0};
     Fraction cd{0};
+    uint64_t signature{0};
+    void update_signature();
+    Fraction root_magnitude() const { return degree > 1 ? radicand : abs(multiplier); }
+    unsigned root_degree() const { return degree > 1 ? degree : 1; }
+    bool combine(const Factors &, bool divide);
 
 public:
     Factors() = default;
-    Factors(Fraction multiplier, Fraction offset, Fraction m, Fraction kg, Fraction s, Fraction A, Fraction K, Fraction mol, Fraction cd) : multiplier{multiplier}, offset{offset}, m{m}, kg{kg}, s{s}, A{A}, K{K}, mol{mol}, cd{cd} {}
-    Fraction get_multiplier() { return multiplier; }
-    void set_multiplier(Fraction m) { multiplier = m; }
-    Factors operator*(Factors);
-    Factors &operator*=(Factors);
-    Factors operator/(Factors);
-    Factors &operator/=(Factors);
+    explicit Factors(const Unit &);
+    Factors(const Unit &, const Prefix &);
+    Factors(Fraction multiplier, Fraction offset, Fraction m, Fraction kg, Fraction s, Fraction A, Fraction K, Fraction mol, Fraction cd);
+    Fraction get_multiplier() const { return multiplier; }
+    const Fraction &get_radicand() const { return radicand; }
+    uint8_t get_degree() const { return degree; }
+    bool is_exact() const { return degree == 1; }
+    void set_root(Fraction radicand, uint8_t degree);
+    Fraction get_offset() const { return offset; }
+    bool has_offset() const { return offset != 0; }
+    bool same_dimension(const Factors &) const;
+    bool operator==(const Factors &) const;
+    uint64_t get_signature() const { return signature; }
+    std::array<Fraction, 7> get_dimension() const { return {m, kg, s, A, K, mol, cd}; }
+    void set_multiplier(Fraction m);
+    Factors operator*(const Factors &) const;
+    Factors &operator*=(const Factors &);
+    Factors operator/(const Factors &) const;
+    Factors &operator/=(const Factors &);
     Factors operator-();
     Factors operator+();
-    Factors &pow(Factors);
+    Factors &pow(const Factors &);
+    bool try_multiply(const Factors &);
+    bool try_divide(const Factors &);
+    bool try_pow(const Factors &);
+    bool try_assign(const Factors &f)
+    {
+        *this = f;
+        return true;
+    }
     friend std::ostream &operator<<(std::ostream &, const Factors &);
+    friend class FastFactors;
 };
 
+class ParseCache
+{
+private:
+    typedef std::list<std::pair<string, Factors>> Entries;
+    size_t capacity;
+    Entries entries{};
+    std::unordered_map<std::string_view, Entries::iterator> index{};
+    mutable std::mutex mutex{};
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    void evict();
+
+public:
+    ParseCache(size_t capacity = 1024) : capacity{capacity} {};
+    std::optional<Factors> find(std::string_view);
+    void insert(std::string_view, const Factors &);
+    std::vector<std::pair<string, Factors>> contents() const;
+    void clear();
+    size_t size() const;
+    size_t get_capacity() const;
+    void set_capacity(size_t);
+    uint64_t get_hits() const { return hits; }
+    uint64_t get_misses() const { return misses; }
+};
+
+typedef std::expected<Factors, ParseError> ParseResult;
+
+class ParseBatch
+{
+public:
+    std::vector<Factors> factors{};
+    std::vector<ParseStatus> status{};
+};
+
+class ThreadPool;
+
 class Parser
 {
 private:
-    TokenStream ts{""};
-    Factors get_expression();
-    Factors get_term();
-    Factors get_unit();
-    Factors get_numberterm(bool inpar = false);
-    Factors get_number();
+    mutable ParseCache cache;
+    const UnitRegistry *registry;
+    const CacheSnapshot *shared_cache{nullptr};
 
 public:
-    Parser() = default;
-    Factors parse(const string &);
+    Parser();
+    Parser(size_t cache_capacity);
+    Parser(const UnitRegistry &, size_t cache_capacity = 1024);
+    static ParseResult try_parse_uncached(std::string_view);
+    static ParseResult try_parse_uncached(std::string_view, const RegistrySnapshot *);
+    static Factors parse_uncached(std::string_view);
+    ParseResult try_parse(std::string_view) const;
+    Factors parse(std::string_view) const;
+    ParseBatch parse_many(std::span<const std::string_view>) const;
+    ParseBatch parse_many(std::span<const std::string_view>, ThreadPool &) const;
+    ParseCache &get_cache() const { return cache; }
+    void set_shared_cache(const CacheSnapshot *snapshot) { shared_cache = snapshot; }
 };
 #endif // PARSER_H
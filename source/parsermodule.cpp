@@ -0,0 +1,679 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <new>
+#include <optional>
+#include <sstream>
+#include <vector>
+#include "canonical.h"
+#include "convert.h"
+#include "lazy.h"
+#include "parser.h"
+#include "reverse.h"
+
+// CPython bindings for nubivis.parser. Unit wraps a Factors; the array
+// functions take any C-contiguous float32/float64 buffer (e.g. a numpy
+// array), work out the result unit once per call and then run the
+// conversion kernel over the data with the GIL released.
+
+static Parser parser{};
+
+typedef struct
+{
+    PyObject_HEAD
+    Factors *factors;
+} UnitObject;
+
+static PyTypeObject UnitType{PyVarObject_HEAD_INIT(nullptr, 0)};
+
+static PyObject *new_unit(const Factors &f)
+{
+    UnitObject *self{PyObject_New(UnitObject, &UnitType)};
+    if (self == nullptr)
+        return nullptr;
+    try
+    {
+        self->factors = new Factors(f);
+    }
+    catch (const std::bad_alloc &)
+    {
+        self->factors = nullptr;
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+    return reinterpret_cast<PyObject *>(self);
+}
+
+static const char *status_name(ParseStatus kind)
+{
+    switch (kind)
+    {
+    case ParseStatus::token_error:
+        return "invalid token";
+    case ParseStatus::unknown_unit:
+        return "unknown unit";
+    case ParseStatus::factors_error:
+        return "invalid unit arithmetic";
+    case ParseStatus::too_deep:
+        return "expression nested too deeply";
+    case ParseStatus::too_long:
+        return "expression too long";
+    default:
+        return "parse error";
+    }
+}
+
+// Runs f with the GIL released. An exception is caught while the GIL is
+// still released and raised as a Python exception once it is taken back,
+// rather than unwinding through the interpreter's frames.
+template <typename F>
+static bool without_gil(F f)
+{
+    std::exception_ptr error{};
+    Py_BEGIN_ALLOW_THREADS
+    try
+    {
+        f();
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    Py_END_ALLOW_THREADS
+    if (!error)
+        return true;
+    try
+    {
+        std::rethrow_exception(error);
+    }
+    catch (const std::bad_alloc &)
+    {
+        PyErr_NoMemory();
+    }
+    catch (const FactorsError &)
+    {
+        PyErr_SetString(PyExc_ValueError, "invalid unit arithmetic");
+    }
+    catch (const ConversionError &)
+    {
+        PyErr_SetString(PyExc_ValueError, "arrays must have the same size");
+    }
+    catch (...)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "array operation failed");
+    }
+    return false;
+}
+
+// Accepts a Unit or a unit expression string.
+static std::optional<Factors> to_factors(PyObject *obj)
+{
+    if (PyObject_TypeCheck(obj, &UnitType))
+        return *reinterpret_cast<UnitObject *>(obj)->factors;
+    if (!PyUnicode_Check(obj))
+    {
+        PyErr_SetString(PyExc_TypeError, "expected a Unit or a unit expression string");
+        return std::nullopt;
+    }
+    Py_ssize_t n{};
+    const char *s{PyUnicode_AsUTF8AndSize(obj, &n)};
+    if (s == nullptr)
+        return std::nullopt;
+    ParseResult r{parser.try_parse(std::string_view(s, n))};
+    if (!r)
+    {
+        PyErr_Format(PyExc_ValueError, "%s at offset %zu in '%s'", status_name(r.error().kind), r.error().offset, s);
+        return std::nullopt;
+    }
+    return *r;
+}
+
+static std::optional<Fraction> to_exponent(PyObject *obj)
+{
+    PyObject *num{PyObject_GetAttrString(obj, "numerator")};
+    PyObject *den{num != nullptr ? PyObject_GetAttrString(obj, "denominator") : nullptr};
+    std::optional<Fraction> e{};
+    if (den == nullptr)
+    {
+        PyErr_Clear();
+        PyErr_SetString(PyExc_TypeError, "exponent must be an int or a fractions.Fraction");
+    }
+    else
+    {
+        long long n{PyLong_AsLongLong(num)};
+        long long d{PyLong_AsLongLong(den)};
+        if (!PyErr_Occurred())
+            e = Fraction(n, d);
+    }
+    Py_XDECREF(num);
+    Py_XDECREF(den);
+    return e;
+}
+
+static Factors exponent_factors(const Fraction &e)
+{
+    return Factors(e, 0, 0, 0, 0, 0, 0, 0, 0);
+}
+
+// The coherent SI unit with the same dimension, which is what the array
+// functions return their results in.
+static Factors coherent(const Factors &f)
+{
+    std::array<Fraction, 7> d{f.get_dimension()};
+    return Factors(1, 0, d[0], d[1], d[2], d[3], d[4], d[5], d[6]);
+}
+
+static PyObject *fraction_tuple(const Fraction &f)
+{
+    if (!f.is_big())
+        return Py_BuildValue("(LL)", static_cast<long long>(f.get_numerator()), static_cast<long long>(f.get_denominator()));
+    BigFraction b{f.to_big()};
+    std::string num{numerator(b).str()};
+    std::string den{denominator(b).str()};
+    return Py_BuildValue("(NN)", PyLong_FromString(num.c_str(), nullptr, 10), PyLong_FromString(den.c_str(), nullptr, 10));
+}
+
+static PyObject *Unit_new(PyTypeObject *, PyObject *args, PyObject *)
+{
+    PyObject *expression{};
+    if (!PyArg_ParseTuple(args, "U", &expression))
+        return nullptr;
+    std::optional<Factors> f{to_factors(expression)};
+    if (!f)
+        return nullptr;
+    return new_unit(*f);
+}
+
+static void Unit_dealloc(UnitObject *self)
+{
+    delete self->factors;
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject *>(self));
+}
+
+static PyObject *Unit_repr(UnitObject *self)
+{
+    std::ostringstream os{};
+    os << *self->factors;
+    return PyUnicode_FromString(os.str().c_str());
+}
+
+static PyObject *Unit_get_multiplier(UnitObject *self, void *)
+{
+    return PyFloat_FromDouble(static_cast<double>(self->factors->get_multiplier()));
+}
+
+static PyObject *Unit_get_offset(UnitObject *self, void *)
+{
+    return PyFloat_FromDouble(static_cast<double>(self->factors->get_offset()));
+}
+
+static PyObject *Unit_get_dimension(UnitObject *self, void *)
+{
+    std::array<Fraction, 7> d{self->factors->get_dimension()};
+    PyObject *t{PyTuple_New(7)};
+    if (t == nullptr)
+        return nullptr;
+    for (size_t i = 0; i < d.size(); i++)
+    {
+        PyObject *item{fraction_tuple(d[i])};
+        if (item == nullptr)
+        {
+            Py_DECREF(t);
+            return nullptr;
+        }
+        PyTuple_SET_ITEM(t, i, item);
+    }
+    return t;
+}
+
+static PyObject *Unit_get_symbol(UnitObject *self, void *)
+{
+    const Unit *u{ReverseLookup::shared().find(coherent(*self->factors))};
+    if (u == nullptr)
+        Py_RETURN_NONE;
+    return PyUnicode_FromStringAndSize(u->name.data(), u->name.size());
+}
+
+static PyObject *Unit_get_id(UnitObject *self, void *)
+{
+    try
+    {
+        return PyLong_FromUnsignedLong(UnitInterner::shared().intern(*self->factors));
+    }
+    catch (const InternError &)
+    {
+        PyErr_SetString(PyExc_OverflowError, "too many distinct units");
+        return nullptr;
+    }
+}
+
+static PyObject *Unit_get_key(UnitObject *self, void *)
+{
+    std::string s{canonical_key(*self->factors)};
+    return PyUnicode_FromStringAndSize(s.data(), s.size());
+}
+
+static Py_hash_t Unit_hash(UnitObject *self)
+{
+    Py_hash_t h{static_cast<Py_hash_t>(FactorsHash{}(*self->factors))};
+    return h == -1 ? -2 : h;
+}
+
+static PyObject *Unit_richcompare(PyObject *a, PyObject *b, int op)
+{
+    if (!PyObject_TypeCheck(a, &UnitType) || !PyObject_TypeCheck(b, &UnitType) || (op != Py_EQ && op != Py_NE))
+        Py_RETURN_NOTIMPLEMENTED;
+    const Factors &x{*reinterpret_cast<UnitObject *>(a)->factors};
+    const Factors &y{*reinterpret_cast<UnitObject *>(b)->factors};
+    return PyBool_FromLong((x == y) == (op == Py_EQ));
+}
+
+template <typename Op>
+static PyObject *unit_binary(PyObject *a, PyObject *b, Op op)
+{
+    if (!PyObject_TypeCheck(a, &UnitType) && !PyUnicode_Check(a))
+        Py_RETURN_NOTIMPLEMENTED;
+    if (!PyObject_TypeCheck(b, &UnitType) && !PyUnicode_Check(b))
+        Py_RETURN_NOTIMPLEMENTED;
+    std::optional<Factors> x{to_factors(a)};
+    if (!x)
+        return nullptr;
+    std::optional<Factors> y{to_factors(b)};
+    if (!y)
+        return nullptr;
+    try
+    {
+        return new_unit(op(*x, *y));
+    }
+    catch (const FactorsError &)
+    {
+        PyErr_SetString(PyExc_ValueError, "invalid unit arithmetic");
+        return nullptr;
+    }
+}
+
+static PyObject *Unit_multiply(PyObject *a, PyObject *b)
+{
+    return unit_binary(a, b, [](const Factors &x, const Factors &y) { return x * y; });
+}
+
+static PyObject *Unit_divide(PyObject *a, PyObject *b)
+{
+    return unit_binary(a, b, [](const Factors &x, const Factors &y) { return x / y; });
+}
+
+static PyObject *Unit_power(PyObject *a, PyObject *b, PyObject *modulo)
+{
+    if (!PyObject_TypeCheck(a, &UnitType) || modulo != Py_None)
+        Py_RETURN_NOTIMPLEMENTED;
+    std::optional<Fraction> e{to_exponent(b)};
+    if (!e)
+        return nullptr;
+    Factors f{*reinterpret_cast<UnitObject *>(a)->factors};
+    if (!f.try_pow(exponent_factors(*e)))
+    {
+        PyErr_SetString(PyExc_ValueError, "invalid unit arithmetic");
+        return nullptr;
+    }
+    return new_unit(f);
+}
+
+static PyGetSetDef Unit_getset[]{
+    {"multiplier", reinterpret_cast<getter>(Unit_get_multiplier), nullptr, "Multiplier to coherent SI units", nullptr},
+    {"offset", reinterpret_cast<getter>(Unit_get_offset), nullptr, "Offset applied before the multiplier", nullptr},
+    {"dimension", reinterpret_cast<getter>(Unit_get_dimension), nullptr, "(numerator, denominator) exponents of m, kg, s, A, K, mol, cd", nullptr},
+    {"symbol", reinterpret_cast<getter>(Unit_get_symbol), nullptr, "Derived SI unit with this dimension, or None", nullptr},
+    {"id", reinterpret_cast<getter>(Unit_get_id), nullptr, "Interned 32-bit id, equal for equal units", nullptr},
+    {"key", reinterpret_cast<getter>(Unit_get_key), nullptr, "Unique key in SI base units, equal for equal units", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+static PyNumberMethods Unit_as_number{};
+
+// Holds a C-contiguous float32 or float64 buffer for the duration of a call.
+class Buffer
+{
+private:
+    Py_buffer view{};
+    bool held{false};
+
+public:
+    Buffer() = default;
+    Buffer(const Buffer &) = delete;
+    Buffer &operator=(const Buffer &) = delete;
+    ~Buffer()
+    {
+        if (held)
+            PyBuffer_Release(&view);
+    }
+    bool acquire(PyObject *obj, bool writable)
+    {
+        int flags{PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | (writable ? PyBUF_WRITABLE : 0)};
+        if (PyObject_GetBuffer(obj, &view, flags) != 0)
+            return false;
+        held = true;
+        if (std::strcmp(format(), "d") != 0 && std::strcmp(format(), "f") != 0)
+        {
+            PyErr_SetString(PyExc_TypeError, "buffer must hold float32 or float64");
+            return false;
+        }
+        return true;
+    }
+    const char *format() const { return view.format != nullptr ? view.format : "B"; }
+    Py_ssize_t size() const { return view.len / view.itemsize; }
+    template <typename T>
+    std::span<T> span() const { return std::span<T>(static_cast<T *>(view.buf), size()); }
+};
+
+// A writable float buffer of n elements, as a memoryview over a bytearray.
+static PyObject *new_array(Py_ssize_t n, const char *format)
+{
+    Py_ssize_t itemsize{std::strcmp(format, "d") == 0 ? static_cast<Py_ssize_t>(sizeof(double)) : static_cast<Py_ssize_t>(sizeof(float))};
+    PyObject *bytes{PyByteArray_FromStringAndSize(nullptr, n * itemsize)};
+    if (bytes == nullptr)
+        return nullptr;
+    PyObject *view{PyMemoryView_FromObject(bytes)};
+    Py_DECREF(bytes);
+    if (view == nullptr)
+        return nullptr;
+    PyObject *typed{PyObject_CallMethod(view, "cast", "s", format)};
+    Py_DECREF(view);
+    return typed;
+}
+
+// Resolves out, acquiring it or allocating a new array; returns a new
+// reference to the object that will be returned to the caller.
+static PyObject *prepare_out(PyObject *out, Buffer &buffer, Py_ssize_t n, const char *format)
+{
+    PyObject *result{};
+    if (out == nullptr || out == Py_None)
+    {
+        result = new_array(n, format);
+        if (result == nullptr)
+            return nullptr;
+    }
+    else
+    {
+        result = out;
+        Py_INCREF(result);
+    }
+    if (!buffer.acquire(result, true))
+    {
+        Py_DECREF(result);
+        return nullptr;
+    }
+    if (buffer.size() != n || std::strcmp(buffer.format(), format) != 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "out must match the input size and type");
+        Py_DECREF(result);
+        return nullptr;
+    }
+    return result;
+}
+
+enum class BinaryOp
+{
+    add,
+    subtract,
+    multiply,
+    divide
+};
+
+// out = a' op b' where a' and b' are a and b in coherent SI units, all in
+// one pass over the data.
+template <typename T>
+static void binary_loop(BinaryOp op, const Factors &fa, const Factors &fb, const Factors &unit,
+                        std::span<const T> a, std::span<const T> b, std::span<T> out)
+{
+    Expression<T> x{a, fa};
+    Expression<T> y{b, fb};
+    switch (op)
+    {
+    case BinaryOp::add:
+        (x + y).evaluate(out, unit, ThreadPool::shared());
+        break;
+    case BinaryOp::subtract:
+        (x - y).evaluate(out, unit, ThreadPool::shared());
+        break;
+    case BinaryOp::multiply:
+        (x * y).evaluate(out, unit, ThreadPool::shared());
+        break;
+    case BinaryOp::divide:
+        (x / y).evaluate(out, unit, ThreadPool::shared());
+        break;
+    }
+}
+
+static PyObject *array_binary(PyObject *args, PyObject *kwargs, BinaryOp op)
+{
+    static const char *keywords[]{"a", "a_unit", "b", "b_unit", "out", nullptr};
+    PyObject *a{}, *ua{}, *b{}, *ub{}, *out{};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOOO|O", const_cast<char **>(keywords), &a, &ua, &b, &ub, &out))
+        return nullptr;
+    std::optional<Factors> fa{to_factors(ua)};
+    if (!fa)
+        return nullptr;
+    std::optional<Factors> fb{to_factors(ub)};
+    if (!fb)
+        return nullptr;
+    Factors ca{coherent(*fa)};
+    Factors cb{coherent(*fb)};
+    Factors unit{ca};
+    if (op == BinaryOp::add || op == BinaryOp::subtract)
+    {
+        if (!fa->same_dimension(*fb))
+        {
+            PyErr_SetString(PyExc_ValueError, "units do not have the same dimension");
+            return nullptr;
+        }
+    }
+    else
+        unit = op == BinaryOp::multiply ? ca * cb : ca / cb;
+    Buffer ba{}, bb{}, bo{};
+    if (!ba.acquire(a, false) || !bb.acquire(b, false))
+        return nullptr;
+    if (ba.size() != bb.size() || std::strcmp(ba.format(), bb.format()) != 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "arrays must have the same size and type");
+        return nullptr;
+    }
+    PyObject *result{prepare_out(out, bo, ba.size(), ba.format())};
+    if (result == nullptr)
+        return nullptr;
+    bool isdouble{std::strcmp(ba.format(), "d") == 0};
+    if (!without_gil([&]
+                     {
+                         if (isdouble)
+                             binary_loop<double>(op, *fa, *fb, unit, ba.span<const double>(), bb.span<const double>(), bo.span<double>());
+                         else
+                             binary_loop<float>(op, *fa, *fb, unit, ba.span<const float>(), bb.span<const float>(), bo.span<float>()); }))
+    {
+        Py_DECREF(result);
+        return nullptr;
+    }
+    PyObject *u{new_unit(unit)};
+    if (u == nullptr)
+    {
+        Py_DECREF(result);
+        return nullptr;
+    }
+    return Py_BuildValue("(NN)", result, u);
+}
+
+static PyObject *array_add(PyObject *, PyObject *args, PyObject *kwargs)
+{
+    return array_binary(args, kwargs, BinaryOp::add);
+}
+
+static PyObject *array_subtract(PyObject *, PyObject *args, PyObject *kwargs)
+{
+    return array_binary(args, kwargs, BinaryOp::subtract);
+}
+
+static PyObject *array_multiply(PyObject *, PyObject *args, PyObject *kwargs)
+{
+    return array_binary(args, kwargs, BinaryOp::multiply);
+}
+
+static PyObject *array_divide(PyObject *, PyObject *args, PyObject *kwargs)
+{
+    return array_binary(args, kwargs, BinaryOp::divide);
+}
+
+template <typename T>
+static void power_loop(const Factors &fa, const Fraction &e, const Factors &unit, std::span<const T> a, std::span<T> out)
+{
+    Expression<T>(a, fa).pow(e).evaluate(out, unit, ThreadPool::shared());
+}
+
+static PyObject *array_power(PyObject *, PyObject *args, PyObject *kwargs)
+{
+    static const char *keywords[]{"a", "a_unit", "exponent", "out", nullptr};
+    PyObject *a{}, *ua{}, *exponent{}, *out{};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOO|O", const_cast<char **>(keywords), &a, &ua, &exponent, &out))
+        return nullptr;
+    std::optional<Factors> fa{to_factors(ua)};
+    if (!fa)
+        return nullptr;
+    std::optional<Fraction> e{to_exponent(exponent)};
+    if (!e)
+        return nullptr;
+    Factors ca{coherent(*fa)};
+    Factors unit{ca};
+    if (!unit.try_pow(exponent_factors(*e)))
+    {
+        PyErr_SetString(PyExc_ValueError, "invalid unit arithmetic");
+        return nullptr;
+    }
+    Buffer ba{}, bo{};
+    if (!ba.acquire(a, false))
+        return nullptr;
+    PyObject *result{prepare_out(out, bo, ba.size(), ba.format())};
+    if (result == nullptr)
+        return nullptr;
+    bool isdouble{std::strcmp(ba.format(), "d") == 0};
+    if (!without_gil([&]
+                     {
+                         if (isdouble)
+                             power_loop<double>(*fa, *e, unit, ba.span<const double>(), bo.span<double>());
+                         else
+                             power_loop<float>(*fa, *e, unit, ba.span<const float>(), bo.span<float>()); }))
+    {
+        Py_DECREF(result);
+        return nullptr;
+    }
+    PyObject *u{new_unit(unit)};
+    if (u == nullptr)
+    {
+        Py_DECREF(result);
+        return nullptr;
+    }
+    return Py_BuildValue("(NN)", result, u);
+}
+
+template <typename T>
+static void convert_loop(const ConversionPlan &plan, std::span<const T> in, std::span<T> out)
+{
+    plan.apply(in, out, ThreadPool::shared());
+}
+
+// Converts in place, or into out, without copying the input.
+static PyObject *array_convert(PyObject *, PyObject *args, PyObject *kwargs)
+{
+    static const char *keywords[]{"array", "from_units", "to_units", "out", nullptr};
+    PyObject *a{}, *from{}, *to{}, *out{};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOO|O", const_cast<char **>(keywords), &a, &from, &to, &out))
+        return nullptr;
+    std::optional<Factors> ffrom{to_factors(from)};
+    if (!ffrom)
+        return nullptr;
+    std::optional<Factors> fto{to_factors(to)};
+    if (!fto)
+        return nullptr;
+    if (!ffrom->same_dimension(*fto))
+    {
+        PyErr_SetString(PyExc_ValueError, "units do not have the same dimension");
+        return nullptr;
+    }
+    bool inplace{out == nullptr || out == Py_None};
+    Buffer ba{}, bo{};
+    if (!ba.acquire(a, inplace))
+        return nullptr;
+    PyObject *result{a};
+    if (inplace)
+        Py_INCREF(result);
+    else if ((result = prepare_out(out, bo, ba.size(), ba.format())) == nullptr)
+        return nullptr;
+    const Buffer &target{inplace ? ba : bo};
+    bool isdouble{std::strcmp(ba.format(), "d") == 0};
+    if (!without_gil([&]
+                     {
+                         ConversionPlan plan{*ffrom, *fto};
+                         if (isdouble)
+                             convert_loop<double>(plan, ba.span<const double>(), target.span<double>());
+                         else
+                             convert_loop<float>(plan, ba.span<const float>(), target.span<float>()); }))
+    {
+        Py_DECREF(result);
+        return nullptr;
+    }
+    return result;
+}
+
+static PyMethodDef parser_methods[]{
+    {"add", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(array_add)), METH_VARARGS | METH_KEYWORDS,
+     "add(a, a_unit, b, b_unit, out=None) -> (out, unit)"},
+    {"subtract", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(array_subtract)), METH_VARARGS | METH_KEYWORDS,
+     "subtract(a, a_unit, b, b_unit, out=None) -> (out, unit)"},
+    {"multiply", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(array_multiply)), METH_VARARGS | METH_KEYWORDS,
+     "multiply(a, a_unit, b, b_unit, out=None) -> (out, unit)"},
+    {"divide", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(array_divide)), METH_VARARGS | METH_KEYWORDS,
+     "divide(a, a_unit, b, b_unit, out=None) -> (out, unit)"},
+    {"power", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(array_power)), METH_VARARGS | METH_KEYWORDS,
+     "power(a, a_unit, exponent, out=None) -> (out, unit)"},
+    {"convert", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(array_convert)), METH_VARARGS | METH_KEYWORDS,
+     "convert(array, from_units, to_units, out=None) -> out, converting in place when out is None"},
+    {nullptr, nullptr, 0, nullptr}};
+
+static PyModuleDef parser_module{
+    PyModuleDef_HEAD_INIT,
+    "nubivis.parser",
+    "Unit expression parser and unit-aware array functions",
+    -1,
+    parser_methods,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr};
+
+PyMODINIT_FUNC PyInit_parser()
+{
+    Unit_as_number.nb_multiply = Unit_multiply;
+    Unit_as_number.nb_true_divide = Unit_divide;
+    Unit_as_number.nb_power = Unit_power;
+    UnitType.tp_name = "nubivis.parser.Unit";
+    UnitType.tp_basicsize = sizeof(UnitObject);
+    UnitType.tp_dealloc = reinterpret_cast<destructor>(Unit_dealloc);
+    UnitType.tp_repr = reinterpret_cast<reprfunc>(Unit_repr);
+    UnitType.tp_as_number = &Unit_as_number;
+    UnitType.tp_flags = Py_TPFLAGS_DEFAULT;
+    UnitType.tp_doc = "Unit(expression) - a unit expression as SI base unit factors";
+    UnitType.tp_richcompare = Unit_richcompare;
+    UnitType.tp_hash = reinterpret_cast<hashfunc>(Unit_hash);
+    UnitType.tp_getset = Unit_getset;
+    UnitType.tp_new = Unit_new;
+    if (PyType_Ready(&UnitType) < 0)
+        return nullptr;
+    PyObject *m{PyModule_Create(&parser_module)};
+    if (m == nullptr)
+        return nullptr;
+    Py_INCREF(&UnitType);
+    if (PyModule_AddObject(m, "Unit", reinterpret_cast<PyObject *>(&UnitType)) < 0)
+    {
+        Py_DECREF(&UnitType);
+        Py_DECREF(m);
+        return nullptr;
+    }
+    return m;
+}
@@ -1,21 +1,323 @@
+#include <array>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <optional>
+#include <sstream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include "parser.h"
+#include "serialize.h"
+#include "stats.h"
 
 using namespace std;
 
-int main(int32_t argc, char **argv)
+// pe [expression...]      parse the arguments, or one line of stdin
+// pe -s [-t | -b]         parse every line of stdin as text, TSV or binary
+//       [-c snapshot]     look expressions up in a cache snapshot first
+//       [-w snapshot]     write the parse cache to a snapshot at the end
+// pe -S ...               also print parser statistics to stderr at the
+//                         end; they are zero unless built with make stats
+
+const size_t BLOCKSIZE{size_t{1} << 20};
+const size_t BATCHLINES{4096};
+const size_t WRITERSIZE{size_t{1} << 16};
+const size_t RENDERCAPACITY{size_t{1} << 16};
+
+enum class Format
+{
+    text,
+    tsv,
+    binary
+};
+
+class Writer
+{
+private:
+    FILE *file{};
+    string buffer{};
+
+public:
+    explicit Writer(FILE *file) : file{file} { buffer.reserve(WRITERSIZE); }
+    Writer(const Writer &) = delete;
+    Writer &operator=(const Writer &) = delete;
+    ~Writer() { flush(); }
+    void write(string_view s)
+    {
+        buffer.append(s);
+        if (buffer.size() >= WRITERSIZE)
+            flush();
+    }
+    void flush()
+    {
+        fwrite(buffer.data(), 1, buffer.size(), file);
+        buffer.clear();
+    }
+};
+
+const char *status_name(ParseStatus status)
+{
+    switch (status)
+    {
+    case ParseStatus::ok:
+        return "ok";
+    case ParseStatus::token_error:
+        return "token_error";
+    case ParseStatus::unknown_unit:
+        return "unknown_unit";
+    case ParseStatus::factors_error:
+        return "factors_error";
+    case ParseStatus::too_deep:
+        return "too_deep";
+    case ParseStatus::too_long:
+        return "too_long";
+    }
+    return "error";
+}
+
+void append_double(string &out, double x)
+{
+    array<char, 32> s{};
+    auto r{to_chars(s.data(), s.data() + s.size(), x)};
+    out.append(s.data(), r.ptr - s.data());
+}
+
+// Backslash, tab, carriage return and newline in the expression are written
+// as \\, \t, \r and \n, so every row keeps its eleven fields.
+void append_escaped(string &out, string_view expression)
+{
+    for (char ch : expression)
+    {
+        switch (ch)
+        {
+        case '\\':
+            out.append("\\\\");
+            break;
+        case '\t':
+            out.append("\\t");
+            break;
+        case '\r':
+            out.append("\\r");
+            break;
+        case '\n':
+            out.append("\\n");
+            break;
+        default:
+            out.push_back(ch);
+        }
+    }
+}
+
+void append_tsv(string &out, string_view expression, ParseStatus status, const Factors &f)
+{
+    append_escaped(out, expression);
+    out.append("\t");
+    out.append(status_name(status));
+    if (status != ParseStatus::ok)
+    {
+        out.append("\t\t\t\t\t\t\t\t\t\n");
+        return;
+    }
+    out.append("\t");
+    append_double(out, static_cast<double>(f.get_multiplier()));
+    out.append("\t");
+    append_double(out, static_cast<double>(f.get_offset()));
+    for (const Fraction &e : f.get_dimension())
+    {
+        out.append("\t");
+        out.append(e.str());
+    }
+    out.append("\n");
+}
+
+// A status byte per line, followed by the encode_factors bytes when ok.
+void append_binary(string &out, ParseStatus status, const Factors &f)
+{
+    out.push_back(static_cast<char>(status));
+    if (status == ParseStatus::ok)
+        encode_factors(f, out);
+}
+
+string render(Format format, string_view expression, ParseStatus status, const Factors &f)
+{
+    string out{};
+    switch (format)
+    {
+    case Format::text:
+    {
+        ostringstream os{};
+        if (status == ParseStatus::ok)
+            os << f << "\n";
+        else
+            os << "error: " << status_name(status) << "\n";
+        out = os.str();
+        break;
+    }
+    case Format::tsv:
+        append_tsv(out, expression, status, f);
+        break;
+    case Format::binary:
+        append_binary(out, status, f);
+        break;
+    }
+    return out;
+}
+
+// Rendered output by expression, so repeated lines skip parsing and
+// formatting altogether.
+typedef unordered_map<string, string, StringHash, equal_to<>> RenderCache;
+
+void write_batch(Writer &w, Format format, const vector<string_view> &lines, const Parser &p, RenderCache &rendered)
+{
+    if (rendered.size() > RENDERCAPACITY)
+        rendered.clear();
+    vector<string_view> misses{};
+    for (string_view line : lines)
+        if (rendered.find(line) == rendered.end())
+            misses.push_back(line);
+    if (!misses.empty())
+    {
+        ParseBatch batch{p.parse_many(misses)};
+        for (size_t i = 0; i < misses.size(); i++)
+            rendered.emplace(misses[i], render(format, misses[i], batch.status[i], batch.factors[i]));
+    }
+    for (string_view line : lines)
+        w.write(rendered.find(line)->second);
+}
+
+// Reads stdin in blocks; a line split across blocks is moved to the front
+// of the buffer before the next read. Returns the exit status.
+int32_t stream(Format format, const string &readpath, const string &writepath)
 {
     Parser p{};
-    if (argc > 1)
+    optional<CacheSnapshot> snapshot{};
+    if (!readpath.empty())
+    {
+        try
+        {
+            snapshot.emplace(readpath);
+        }
+        catch (const SerializationError &)
+        {
+            cerr << "pe: cannot read snapshot " << readpath << endl;
+            return 1;
+        }
+        p.set_shared_cache(&*snapshot);
+    }
+    Writer w{stdout};
+    RenderCache rendered{};
+    vector<char> block(BLOCKSIZE);
+    vector<string_view> lines{};
+    size_t used{0};
+    bool eof{false};
+    while (!eof)
+    {
+        if (used == block.size())
+            block.resize(block.size() * 2);
+        size_t n{fread(block.data() + used, 1, block.size() - used, stdin)};
+        eof = n == 0;
+        used += n;
+        size_t start{0};
+        for (size_t i = 0; i < used; i++)
+        {
+            if (block[i] != '\n' && !(eof && i + 1 == used))
+                continue;
+            size_t end{block[i] == '\n' ? i : i + 1};
+            if (end > start && block[end - 1] == '\r')
+                end--;
+            lines.emplace_back(block.data() + start, end - start);
+            start = i + 1;
+            if (lines.size() == BATCHLINES)
+            {
+                write_batch(w, format, lines, p, rendered);
+                lines.clear();
+            }
+        }
+        write_batch(w, format, lines, p, rendered);
+        lines.clear();
+        memmove(block.data(), block.data() + start, used - start);
+        used -= start;
+    }
+    if (!writepath.empty())
+    {
+        try
+        {
+            CacheSnapshot::write(writepath, p.get_cache().contents());
+        }
+        catch (const SerializationError &)
+        {
+            cerr << "pe: cannot write snapshot " << writepath << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void print_stats()
+{
+    ParseStats s{get_parse_stats()};
+    cerr << "parses " << s.parses << "\n"
+         << "tokens " << s.tokens << "\n"
+         << "unit_lookups " << s.unit_lookups << "\n"
+         << "ambiguous_matches " << s.ambiguous_matches << "\n"
+         << "prefix_fallbacks " << s.prefix_fallbacks << "\n"
+         << "max_depth " << s.max_depth << "\n"
+         << "arena_allocations " << s.arena_allocations << "\n"
+         << "heap_allocations " << s.heap_allocations << "\n";
+    for (size_t i = 0; i < LATENCYBUCKETS; i++)
+        if (s.latency[i] != 0)
+            cerr << "latency_ns " << (uint64_t{1} << i) << " " << s.latency[i] << "\n";
+}
+
+int main(int32_t argc, char **argv)
+{
+    bool stats{argc > 1 && argv[1] == string_view("-S")};
+    if (stats)
+    {
+        argc--;
+        argv++;
+    }
+    if (argc > 1 && argv[1] == string_view("-s"))
+    {
+        Format format{Format::text};
+        string readpath{};
+        string writepath{};
+        for (int32_t i = 2; i < argc; i++)
+        {
+            if (argv[i] == string_view("-t"))
+                format = Format::tsv;
+            else if (argv[i] == string_view("-b"))
+                format = Format::binary;
+            else if (argv[i] == string_view("-c") && i + 1 < argc)
+                readpath = argv[++i];
+            else if (argv[i] == string_view("-w") && i + 1 < argc)
+                writepath = argv[++i];
+            else
+            {
+                cerr << "usage: pe [-S] -s [-t | -b] [-c snapshot] [-w snapshot]" << endl;
+                return 2;
+            }
+        }
+        int32_t status{stream(format, readpath, writepath)};
+        if (stats)
+            print_stats();
+        return status;
+    }
+    else if (argc > 1)
     {
+        Parser p{};
         for (int32_t i = 1; i < argc; i++)
             cout << p.parse(argv[i]) << endl;
     }
     else
     {
+        Parser p{};
         string e;
         getline(cin, e);
         cout << p.parse(e) << endl;
     }
+    if (stats)
+        print_stats();
 }
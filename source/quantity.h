@@ -0,0 +1,87 @@
+#ifndef QUANTITY_H
+#define QUANTITY_H
+#include <compare>
+#include <string_view>
+#include "convert.h"
+#include "units.h"
+
+consteval Dimension dimension(std::string_view expression)
+{
+    return units(expression).get_dimension();
+}
+
+// A value in coherent SI units whose dimension is part of the type, so that
+// arithmetic is checked at compile time and costs no more than T itself.
+template <typename T, Dimension D>
+class Quantity
+{
+private:
+    T value{};
+
+public:
+    static constexpr Dimension dimension{D};
+
+    constexpr Quantity() = default;
+    constexpr explicit Quantity(T value) : value{value} {}
+    constexpr T get_value() const { return value; }
+
+    constexpr Quantity operator+() const { return *this; }
+    constexpr Quantity operator-() const { return Quantity(-value); }
+    constexpr Quantity operator+(Quantity o) const { return Quantity(value + o.value); }
+    constexpr Quantity operator-(Quantity o) const { return Quantity(value - o.value); }
+    constexpr Quantity &operator+=(Quantity o)
+    {
+        value += o.value;
+        return *this;
+    }
+    constexpr Quantity &operator-=(Quantity o)
+    {
+        value -= o.value;
+        return *this;
+    }
+    constexpr Quantity operator*(T x) const { return Quantity(value * x); }
+    constexpr Quantity operator/(T x) const { return Quantity(value / x); }
+    constexpr Quantity &operator*=(T x)
+    {
+        value *= x;
+        return *this;
+    }
+    constexpr Quantity &operator/=(T x)
+    {
+        value /= x;
+        return *this;
+    }
+    template <Dimension E>
+    constexpr Quantity<T, D * E> operator*(Quantity<T, E> o) const { return Quantity<T, D * E>(value * o.get_value()); }
+    template <Dimension E>
+    constexpr Quantity<T, D / E> operator/(Quantity<T, E> o) const { return Quantity<T, D / E>(value / o.get_value()); }
+    constexpr auto operator<=>(const Quantity &) const = default;
+
+    static Factors get_factors() { return FastFactors(1, 0, D).to_factors(); }
+
+    // Convert from and to a runtime unit expression; throws FactorsError if
+    // the expression does not have dimension D.
+    static Quantity from(T x, std::string_view unit, const Parser &parser)
+    {
+        return Quantity(static_cast<T>(ConversionPlan(parser.parse(unit), get_factors())(x)));
+    }
+    T in(std::string_view unit, const Parser &parser) const
+    {
+        return static_cast<T>(ConversionPlan(get_factors(), parser.parse(unit))(value));
+    }
+};
+
+template <typename T, Dimension D>
+constexpr Quantity<T, D> operator*(T x, Quantity<T, D> q)
+{
+    return q * x;
+}
+
+template <typename T, Dimension D>
+constexpr Quantity<T, Dimension{} / D> operator/(T x, Quantity<T, D> q)
+{
+    return Quantity<T, Dimension{} / D>(x / q.get_value());
+}
+
+static_assert(sizeof(Quantity<double, dimension("m")>) == sizeof(double));
+#endif // QUANTITY_H
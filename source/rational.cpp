@@ -0,0 +1,296 @@
+#include <bit>
+#include <cmath>
+#include <new>
+#include <algorithm>
+#include <numeric>
+#include "parser.h"
+
+// Quotients of integers up to these bounds are exact before the division,
+// so a single correctly rounded division gives the nearest value.
+const int64_t DOUBLEEXACT{int64_t{1} << 53};
+const int64_t FLOATEXACT{int64_t{1} << 24};
+
+bool fits(int64_t x)
+{
+    return x != INT64_MIN;
+}
+
+bool Fraction::set_small(int64_t n, int64_t d)
+{
+    if (!fits(n) || !fits(d))
+        return false;
+    if (d < 0)
+    {
+        n = -n;
+        d = -d;
+    }
+    int64_t g{std::gcd(n, d)};
+    if (g > 1)
+    {
+        n /= g;
+        d /= g;
+    }
+    release(big);
+    big = nullptr;
+    num = n;
+    den = d;
+    return true;
+}
+
+void Fraction::assign(const BigFraction &x)
+{
+    const BigInteger &n{numerator(x)};
+    const BigInteger &d{denominator(x)};
+    if (n >= -INT64_MAX && n <= INT64_MAX && d <= INT64_MAX)
+    {
+        release(big);
+        big = nullptr;
+        num = static_cast<int64_t>(n);
+        den = static_cast<int64_t>(d);
+        return;
+    }
+    if (big != nullptr)
+        *big = x;
+    else
+        big = clone(x);
+}
+
+BigFraction *Fraction::clone(const BigFraction &x)
+{
+    return new (ParseSession::allocate(sizeof(BigFraction))) BigFraction(x);
+}
+
+void Fraction::release(BigFraction *x)
+{
+    if (x == nullptr)
+        return;
+    x->~BigFraction();
+    ParseSession::deallocate(x);
+}
+
+Fraction::Fraction(int64_t n, int64_t d)
+{
+    if (d == 0)
+        throw FactorsError();
+    if (set_small(n, d))
+        return;
+    // BigFraction rejects a negative denominator.
+    BigInteger bn(n), bd(d);
+    if (d < 0)
+    {
+        bn = -bn;
+        bd = -bd;
+    }
+    assign(BigFraction(bn, bd));
+}
+
+// A finite double is m * 2**e exactly for a 53-bit integer m.
+Fraction::Fraction(double x)
+{
+    if (!std::isfinite(x))
+        throw FactorsError();
+    int e{};
+    double m{std::frexp(x, &e)};
+    int64_t n{static_cast<int64_t>(std::ldexp(m, 53))};
+    e -= 53;
+    if (n == 0)
+        return;
+    int zeros{__builtin_ctzll(static_cast<uint64_t>(n))};
+    n >>= zeros;
+    e += zeros;
+    int bits{64 - __builtin_clzll(static_cast<uint64_t>(n < 0 ? -n : n))};
+    if (e >= 0 && e + bits <= 62)
+        num = n * (int64_t{1} << e);
+    else if (e < 0 && e >= -62)
+    {
+        num = n;
+        den = int64_t{1} << -e;
+    }
+    else
+        assign(BigFraction(x));
+}
+
+Fraction::Fraction(const Fraction &o) : num{o.num}, den{o.den}, big{o.big != nullptr ? clone(*o.big) : nullptr}
+{
+}
+
+Fraction::Fraction(Fraction &&o) noexcept : num{o.num}, den{o.den}, big{o.big}
+{
+    o.num = 0;
+    o.den = 1;
+    o.big = nullptr;
+}
+
+Fraction &Fraction::operator=(const Fraction &o)
+{
+    if (this == &o)
+        return *this;
+    if (o.big != nullptr)
+        assign(*o.big);
+    else
+    {
+        release(big);
+        big = nullptr;
+        num = o.num;
+        den = o.den;
+    }
+    return *this;
+}
+
+Fraction &Fraction::operator=(Fraction &&o) noexcept
+{
+    if (this == &o)
+        return *this;
+    release(big);
+    num = o.num;
+    den = o.den;
+    big = o.big;
+    o.num = 0;
+    o.den = 1;
+    o.big = nullptr;
+    return *this;
+}
+
+bool Fraction::is_integer() const
+{
+    return big != nullptr ? denominator(*big) == 1 : den == 1;
+}
+
+size_t Fraction::bits() const
+{
+    if (big != nullptr)
+        return std::max(msb(abs(numerator(*big))), msb(denominator(*big))) + 1;
+    uint64_t n{static_cast<uint64_t>(num < 0 ? -num : num)};
+    return std::max(std::bit_width(n), std::bit_width(static_cast<uint64_t>(den)));
+}
+
+BigFraction Fraction::to_big() const
+{
+    if (big != nullptr)
+        return *big;
+    return BigFraction(BigInteger(num), BigInteger(den));
+}
+
+std::string Fraction::str() const
+{
+    if (big != nullptr)
+        return big->str();
+    if (den == 1)
+        return std::to_string(num);
+    return std::to_string(num) + "/" + std::to_string(den);
+}
+
+Fraction::operator double() const
+{
+    if (big == nullptr && num >= -DOUBLEEXACT && num <= DOUBLEEXACT && den <= DOUBLEEXACT)
+        return static_cast<double>(num) / static_cast<double>(den);
+    return static_cast<double>(to_big());
+}
+
+Fraction::operator float() const
+{
+    if (big == nullptr && num >= -FLOATEXACT && num <= FLOATEXACT && den <= FLOATEXACT)
+        return static_cast<float>(num) / static_cast<float>(den);
+    return static_cast<float>(to_big());
+}
+
+// (a/b) + (c/d) over the reduced common denominator b/g * d.
+Fraction &Fraction::operator+=(const Fraction &o)
+{
+    if (big == nullptr && o.big == nullptr)
+    {
+        int64_t g{std::gcd(den, o.den)};
+        int64_t x{}, y{}, n{}, d{};
+        if (!__builtin_mul_overflow(num, o.den / g, &x) &&
+            !__builtin_mul_overflow(o.num, den / g, &y) &&
+            !__builtin_add_overflow(x, y, &n) &&
+            !__builtin_mul_overflow(den / g, o.den, &d) &&
+            set_small(n, d))
+            return *this;
+    }
+    assign(to_big() + o.to_big());
+    return *this;
+}
+
+Fraction &Fraction::operator-=(const Fraction &o)
+{
+    return *this += -o;
+}
+
+// Cross-cancelling first keeps the products in lowest terms.
+Fraction &Fraction::operator*=(const Fraction &o)
+{
+    if (big == nullptr && o.big == nullptr)
+    {
+        if (num == 0 || o.num == 0)
+            return *this = Fraction();
+        int64_t g{std::gcd(num, o.den)};
+        int64_t h{std::gcd(o.num, den)};
+        int64_t n{}, d{};
+        if (!__builtin_mul_overflow(num / g, o.num / h, &n) &&
+            !__builtin_mul_overflow(den / h, o.den / g, &d) &&
+            set_small(n, d))
+            return *this;
+    }
+    assign(to_big() * o.to_big());
+    return *this;
+}
+
+Fraction &Fraction::operator/=(const Fraction &o)
+{
+    if (o == 0)
+        throw FactorsError();
+    if (o.big != nullptr)
+    {
+        assign(to_big() / *o.big);
+        return *this;
+    }
+    Fraction inverse{};
+    inverse.num = o.num < 0 ? -o.den : o.den;
+    inverse.den = o.num < 0 ? -o.num : o.num;
+    return *this *= inverse;
+}
+
+Fraction Fraction::operator-() const
+{
+    if (big == nullptr)
+    {
+        Fraction r{};
+        r.num = -num;
+        r.den = den;
+        return r;
+    }
+    return Fraction(BigFraction(-*big));
+}
+
+bool operator==(const Fraction &a, const Fraction &b)
+{
+    if (a.big == nullptr && b.big == nullptr)
+        return a.num == b.num && a.den == b.den;
+    if (a.big == nullptr || b.big == nullptr)
+        return false;
+    return *a.big == *b.big;
+}
+
+std::strong_ordering operator<=>(const Fraction &a, const Fraction &b)
+{
+    if (a.big == nullptr && b.big == nullptr)
+        return static_cast<__int128>(a.num) * b.den <=> static_cast<__int128>(b.num) * a.den;
+    BigFraction x{a.to_big()};
+    BigFraction y{b.to_big()};
+    if (x < y)
+        return std::strong_ordering::less;
+    if (x > y)
+        return std::strong_ordering::greater;
+    return std::strong_ordering::equal;
+}
+
+std::ostream &operator<<(std::ostream &os, const Fraction &x)
+{
+    return os << x.str();
+}
+
+Fraction abs(const Fraction &x)
+{
+    return x < 0 ? -x : x;
+}
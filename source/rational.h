@@ -0,0 +1,77 @@
+#ifndef RATIONAL_H
+#define RATIONAL_H
+#include <compare>
+#include <concepts>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <boost/multiprecision/cpp_int.hpp>
+#include "arena.h"
+
+typedef boost::multiprecision::cpp_int_backend<0, 0, boost::multiprecision::signed_magnitude, boost::multiprecision::unchecked, SessionAllocator<boost::multiprecision::limb_type>> IntegerBackend;
+typedef boost::multiprecision::number<IntegerBackend> BigInteger;
+typedef boost::multiprecision::number<boost::multiprecision::rational_adaptor<IntegerBackend>> BigFraction;
+
+// A rational with an int64 numerator and denominator, checked for overflow
+// on every operation and promoted to a BigFraction only when a result does
+// not fit. A value is big exactly when it cannot be held in lowest terms
+// with both parts in [-INT64_MAX, INT64_MAX], so equal values always have
+// the same representation. Big values live in ParseSession memory like the
+// limbs of their integers.
+class Fraction
+{
+private:
+    int64_t num{0};
+    int64_t den{1};
+    BigFraction *big{nullptr};
+    bool set_small(int64_t n, int64_t d);
+    void assign(const BigFraction &);
+    static BigFraction *clone(const BigFraction &);
+    static void release(BigFraction *);
+
+public:
+    Fraction() = default;
+    template <std::integral I>
+    Fraction(I n)
+    {
+        if (std::cmp_greater_equal(n, -INT64_MAX) && std::cmp_less_equal(n, INT64_MAX))
+            num = static_cast<int64_t>(n);
+        else
+            assign(BigFraction(n));
+    }
+    Fraction(int64_t n, int64_t d);
+    explicit Fraction(double);
+    explicit Fraction(const BigFraction &x) { assign(x); }
+    Fraction(const Fraction &);
+    Fraction(Fraction &&) noexcept;
+    Fraction &operator=(const Fraction &);
+    Fraction &operator=(Fraction &&) noexcept;
+    ~Fraction() { release(big); }
+    bool is_big() const { return big != nullptr; }
+    bool is_integer() const;
+    // The parts of a value that is not big.
+    int64_t get_numerator() const { return num; }
+    int64_t get_denominator() const { return den; }
+    // The bit length of the longer of numerator and denominator.
+    size_t bits() const;
+    BigFraction to_big() const;
+    std::string str() const;
+    explicit operator double() const;
+    explicit operator float() const;
+    Fraction &operator+=(const Fraction &);
+    Fraction &operator-=(const Fraction &);
+    Fraction &operator*=(const Fraction &);
+    Fraction &operator/=(const Fraction &);
+    Fraction operator-() const;
+    friend Fraction operator+(Fraction a, const Fraction &b) { return a += b; }
+    friend Fraction operator-(Fraction a, const Fraction &b) { return a -= b; }
+    friend Fraction operator*(Fraction a, const Fraction &b) { return a *= b; }
+    friend Fraction operator/(Fraction a, const Fraction &b) { return a /= b; }
+    friend bool operator==(const Fraction &, const Fraction &);
+    friend std::strong_ordering operator<=>(const Fraction &, const Fraction &);
+    friend std::ostream &operator<<(std::ostream &, const Fraction &);
+};
+
+Fraction abs(const Fraction &);
+#endif // RATIONAL_H
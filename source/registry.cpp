@@ -0,0 +1,66 @@
+#include "registry.h"
+#include "trie.h"
+
+const Factors *RegistrySnapshot::find(std::string_view name) const
+{
+    auto it{units.find(name)};
+    return it == units.end() ? nullptr : &it->second;
+}
+
+std::atomic<uint64_t> nextregistry{1};
+
+UnitRegistry::UnitRegistry() : current{std::make_shared<const RegistrySnapshot>()}, id{nextregistry++}
+{
+}
+
+// A name must lex as a single unit token, must not be one the builtin
+// grammar already resolves, either as a unit or as a prefixed SI unit, and
+// must not be registered already, so that a registration never changes
+// what an expression that parsed before means and no cached result can go
+// stale.
+void UnitRegistry::add(std::string_view name, const Factors &f)
+{
+    for (size_t i = 0, n = 0; i < name.size(); i += n)
+        if ((n = letter_length(name, i)) == 0)
+            throw RegistryError();
+    if (name.empty())
+        throw RegistryError();
+    UnitMatch match{UnitTrie::builtin().find(name)};
+    if (match.unit != nullptr || match.prefix != nullptr)
+        throw RegistryError();
+    std::lock_guard<std::mutex> lock{writer};
+    auto next{std::make_shared<RegistrySnapshot>(*snapshot())};
+    if (!next->units.try_emplace(string(name), f).second)
+        throw RegistryError();
+    uint64_t g{next->get_generation()};
+    current.store(std::move(next), std::memory_order_release);
+    generation.store(g, std::memory_order_release);
+}
+
+// The snapshot stays valid until the calling thread next calls local().
+// The generation is read before the snapshot, so the snapshot loaded is at
+// least as new as the generation compared against.
+const RegistrySnapshot *UnitRegistry::local() const
+{
+    struct Local
+    {
+        uint64_t registry{0};
+        uint64_t generation{0};
+        std::shared_ptr<const RegistrySnapshot> snapshot{};
+    };
+    thread_local Local local{};
+    uint64_t g{generation.load(std::memory_order_acquire)};
+    if (local.registry != id || local.generation != g)
+    {
+        local.snapshot = snapshot();
+        local.registry = id;
+        local.generation = g;
+    }
+    return local.snapshot.get();
+}
+
+UnitRegistry &UnitRegistry::shared()
+{
+    static UnitRegistry registry{};
+    return registry;
+}
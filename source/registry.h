@@ -0,0 +1,53 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "parser.h"
+
+class RegistryError
+{
+public:
+    RegistryError() = default;
+};
+
+// An immutable set of custom units; its generation counts registrations.
+class RegistrySnapshot
+{
+private:
+    std::unordered_map<string, Factors, StringHash, std::equal_to<>> units{};
+    friend class UnitRegistry;
+
+public:
+    const Factors *find(std::string_view) const;
+    uint64_t get_generation() const { return units.size(); }
+};
+
+// Writers serialize on a mutex, copy the snapshot, publish the copy and
+// then bump generation. std::atomic<std::shared_ptr> is not lock-free in
+// libstdc++, so readers on the parse path call local(), which compares the
+// plain atomic generation with that of the snapshot the calling thread
+// last loaded and goes through the shared_ptr only when a unit has been
+// added since. A superseded snapshot is freed once no reader holds it.
+class UnitRegistry
+{
+private:
+    std::atomic<std::shared_ptr<const RegistrySnapshot>> current{};
+    std::atomic<uint64_t> generation{0};
+    const uint64_t id;
+    std::mutex writer{};
+
+public:
+    UnitRegistry();
+    UnitRegistry(const UnitRegistry &) = delete;
+    UnitRegistry &operator=(const UnitRegistry &) = delete;
+    void add(std::string_view name, const Factors &);
+    std::shared_ptr<const RegistrySnapshot> snapshot() const { return current.load(std::memory_order_acquire); }
+    const RegistrySnapshot *local() const;
+    static UnitRegistry &shared();
+};
+#endif // REGISTRY_H
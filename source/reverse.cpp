@@ -0,0 +1,67 @@
+#include <cmath>
+#include "reverse.h"
+
+// Engineering prefixes from femto to peta, indexed by (exponent + 15) / 3.
+const Prefix *const ENGINEERING[]{
+    PREFIXES.find("f"),
+    PREFIXES.find("p"),
+    PREFIXES.find("n"),
+    PREFIXES.find("µ"),
+    PREFIXES.find("m"),
+    nullptr,
+    PREFIXES.find("k"),
+    PREFIXES.find("M"),
+    PREFIXES.find("G"),
+    PREFIXES.find("T"),
+    PREFIXES.find("P"),
+};
+
+// Each dimension maps to its coherent unit, the kilogram for mass.
+ReverseLookup::ReverseLookup()
+{
+    for (const Unit &u : SIUNITS)
+    {
+        if (!u.multiplier.exact() || u.multiplier.num != u.multiplier.den || u.offset.value != 0)
+            continue;
+        uint64_t k{unit_signature(u)};
+        if (k == 0)
+            continue;
+        index.try_emplace(k, &u);
+    }
+}
+
+const Unit *ReverseLookup::find(const Factors &f) const
+{
+    auto it{index.find(f.get_signature())};
+    if (it == index.end())
+        return nullptr;
+    return it->second;
+}
+
+// Prefixes attach to the gram, not to the kilogram.
+const Unit &ReverseLookup::prefix_base(const Unit &u)
+{
+    return u.name == "kg" ? *SIUNITS.find("g") : u;
+}
+
+// The engineering prefix for multiplier times the coherent unit u, to be
+// written before prefix_base(u): 0.002 kg is 2 g and 2000 kg is 2 Mg.
+const Prefix *ReverseLookup::suggest_prefix(double multiplier, const Unit &u)
+{
+    multiplier /= prefix_base(u).multiplier.value;
+    if (multiplier == 0 || !std::isfinite(multiplier))
+        return nullptr;
+    int exponent{static_cast<int>(std::floor(std::log10(std::abs(multiplier)) + 1e-9))};
+    int i{static_cast<int>(std::floor(exponent / 3.0)) + 5};
+    if (i < 0)
+        i = 0;
+    if (i > 10)
+        i = 10;
+    return ENGINEERING[i];
+}
+
+const ReverseLookup &ReverseLookup::shared()
+{
+    static const ReverseLookup lookup{};
+    return lookup;
+}
@@ -0,0 +1,19 @@
+#ifndef REVERSE_H
+#define REVERSE_H
+#include <cstdint>
+#include <unordered_map>
+#include "parser.h"
+
+class ReverseLookup
+{
+private:
+    std::unordered_map<uint64_t, const Unit *> index{};
+
+public:
+    ReverseLookup();
+    const Unit *find(const Factors &) const;
+    static const Unit &prefix_base(const Unit &);
+    static const Prefix *suggest_prefix(double, const Unit &);
+    static const ReverseLookup &shared();
+};
+#endif // REVERSE_H
@@ -0,0 +1,360 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include "serialize.h"
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SERIALIZE_MMAP
+#endif
+
+const char SNAPSHOTMAGIC[8]{'N', 'U', 'B', 'I', 'C', 'A', 'C', 'H'};
+const uint32_t SNAPSHOTBYTEORDER{0x01020304};
+const uint32_t SNAPSHOTVERSION{2};
+// A bound on numerator and denominator length that no real unit reaches,
+// so a corrupt length cannot trigger a huge allocation.
+const uint64_t FRACTIONMAXBYTES{1 << 16};
+
+void put_varint(std::string &out, uint64_t x)
+{
+    while (x >= 0x80)
+    {
+        out.push_back(static_cast<char>(x | 0x80));
+        x >>= 7;
+    }
+    out.push_back(static_cast<char>(x));
+}
+
+uint64_t get_varint(std::span<const std::byte> in, size_t &pos)
+{
+    uint64_t x{0};
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (pos >= in.size())
+            throw SerializationError();
+        uint8_t b{static_cast<uint8_t>(in[pos++])};
+        x |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if ((b & 0x80) == 0)
+            return x;
+    }
+    throw SerializationError();
+}
+
+void put_magnitude(std::string &out, uint64_t x, bool negative, bool sign)
+{
+    size_t length{(std::bit_width(x) + 7) / 8};
+    put_varint(out, sign ? length << 1 | negative : length);
+    for (size_t i = 0; i < length; i++)
+        out.push_back(static_cast<char>(x >> (8 * i)));
+}
+
+void put_integer(std::string &out, const BigInteger &x, bool sign)
+{
+    std::vector<uint8_t> bytes{};
+    if (x != 0)
+        boost::multiprecision::export_bits(x, std::back_inserter(bytes), 8, false);
+    put_varint(out, sign ? bytes.size() << 1 | (x < 0) : bytes.size());
+    out.append(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+}
+
+void put_fraction(std::string &out, const Fraction &x)
+{
+    if (x.is_big())
+    {
+        BigFraction b{x.to_big()};
+        put_integer(out, numerator(b), true);
+        put_integer(out, denominator(b), false);
+        return;
+    }
+    int64_t n{x.get_numerator()};
+    put_magnitude(out, n < 0 ? -static_cast<uint64_t>(n) : static_cast<uint64_t>(n), n < 0, true);
+    put_magnitude(out, static_cast<uint64_t>(x.get_denominator()), false, false);
+}
+
+std::span<const std::byte> get_bytes(std::span<const std::byte> in, size_t &pos, bool sign, bool &negative)
+{
+    uint64_t length{get_varint(in, pos)};
+    negative = sign && (length & 1) != 0;
+    if (sign)
+        length >>= 1;
+    if (length > FRACTIONMAXBYTES || length > in.size() - pos)
+        throw SerializationError();
+    pos += length;
+    return in.subspan(pos - length, length);
+}
+
+bool get_small(std::span<const std::byte> bytes, bool negative, int64_t &x)
+{
+    if (bytes.size() > sizeof(uint64_t))
+        return false;
+    uint64_t m{0};
+    for (size_t i = 0; i < bytes.size(); i++)
+        m |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+    if (m > INT64_MAX)
+        return false;
+    x = negative ? -static_cast<int64_t>(m) : static_cast<int64_t>(m);
+    return true;
+}
+
+BigInteger get_big(std::span<const std::byte> bytes, bool negative)
+{
+    BigInteger x{0};
+    if (!bytes.empty())
+    {
+        const uint8_t *begin{reinterpret_cast<const uint8_t *>(bytes.data())};
+        boost::multiprecision::import_bits(x, begin, begin + bytes.size(), 8, false);
+    }
+    return negative ? BigInteger(-x) : x;
+}
+
+void encode_factors(const Factors &f, std::string &out)
+{
+    std::array<Fraction, 7> d{f.get_dimension()};
+    for (const Fraction &x : {f.get_multiplier(), f.get_offset(), d[0], d[1], d[2], d[3], d[4], d[5], d[6]})
+        put_fraction(out, x);
+    put_varint(out, f.get_degree());
+    if (f.get_degree() > 1)
+        put_fraction(out, f.get_radicand());
+}
+
+// Parts of up to 63 bits are read straight into a Fraction; only longer
+// ones go through BigInteger.
+Fraction get_fraction(std::span<const std::byte> in, size_t &pos)
+{
+    bool nnegative{}, dnegative{};
+    std::span<const std::byte> nbytes{get_bytes(in, pos, true, nnegative)};
+    std::span<const std::byte> dbytes{get_bytes(in, pos, false, dnegative)};
+    int64_t num{}, den{};
+    if (get_small(nbytes, nnegative, num) && get_small(dbytes, false, den))
+    {
+        if (den == 0)
+            throw SerializationError();
+        return Fraction(num, den);
+    }
+    BigInteger bnum{get_big(nbytes, nnegative)};
+    BigInteger bden{get_big(dbytes, false)};
+    if (bden == 0)
+        throw SerializationError();
+    return Fraction(BigFraction(bnum, bden));
+}
+
+// A root whose radicand is not positive or whose degree does not fit is
+// rejected, since no parse produces one.
+Factors decode_factors(std::span<const std::byte> in, size_t &pos)
+{
+    std::array<Fraction, 9> x{};
+    for (Fraction &value : x)
+        value = get_fraction(in, pos);
+    Factors f{x[0], x[1], x[2], x[3], x[4], x[5], x[6], x[7], x[8]};
+    uint64_t degree{get_varint(in, pos)};
+    if (degree > UINT8_MAX)
+        throw SerializationError();
+    Fraction radicand{1};
+    if (degree > 1 && (radicand = get_fraction(in, pos)) <= 0)
+        throw SerializationError();
+    f.set_root(std::move(radicand), static_cast<uint8_t>(degree));
+    return f;
+}
+
+// FNV-1a, which unlike std::hash is the same in every process and build.
+uint64_t snapshot_hash(std::string_view s)
+{
+    uint64_t h{14695981039346656037ull};
+    for (char ch : s)
+    {
+        h ^= static_cast<unsigned char>(ch);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// Expressions that use a registered unit are left out, since another
+// process may register a different unit under the same name. What is left
+// parses the same under any registry, because a registered name can never
+// be one the builtin grammar resolves.
+std::vector<std::byte> CacheSnapshot::build(std::span<const std::pair<string, Factors>> contents)
+{
+    std::vector<size_t> order{};
+    std::vector<uint64_t> hashes(contents.size());
+    for (size_t i = 0; i < contents.size(); i++)
+    {
+        if (!Parser::try_parse_uncached(contents[i].first, nullptr))
+            continue;
+        order.push_back(i);
+        hashes[i] = snapshot_hash(contents[i].first);
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b)
+              { return hashes[a] != hashes[b] ? hashes[a] < hashes[b] : contents[a].first < contents[b].first; });
+    order.erase(std::unique(order.begin(), order.end(), [&](size_t a, size_t b)
+                            { return contents[a].first == contents[b].first; }),
+                order.end());
+    std::string keys{};
+    std::string values{};
+    std::vector<Entry> entries{};
+    for (size_t i : order)
+    {
+        Entry e{};
+        e.hash = hashes[i];
+        e.key = keys.size();
+        e.keylength = static_cast<uint32_t>(contents[i].first.size());
+        keys.append(contents[i].first);
+        e.value = values.size();
+        encode_factors(contents[i].second, values);
+        e.valuelength = static_cast<uint32_t>(values.size() - e.value);
+        entries.push_back(e);
+    }
+    Header h{};
+    std::memcpy(h.magic, SNAPSHOTMAGIC, sizeof(h.magic));
+    h.byteorder = SNAPSHOTBYTEORDER;
+    h.version = SNAPSHOTVERSION;
+    h.count = entries.size();
+    h.keys = sizeof(Header) + entries.size() * sizeof(Entry);
+    h.values = h.keys + keys.size();
+    h.size = h.values + values.size();
+    for (Entry &e : entries)
+    {
+        e.key += h.keys;
+        e.value += h.values;
+    }
+    std::vector<std::byte> out(h.size);
+    std::memcpy(out.data(), &h, sizeof(h));
+    std::copy_n(reinterpret_cast<const std::byte *>(entries.data()), entries.size() * sizeof(Entry), out.data() + sizeof(h));
+    std::copy_n(reinterpret_cast<const std::byte *>(keys.data()), keys.size(), out.data() + h.keys);
+    std::copy_n(reinterpret_cast<const std::byte *>(values.data()), values.size(), out.data() + h.values);
+    return out;
+}
+
+void CacheSnapshot::write(const std::string &path, std::span<const std::pair<string, Factors>> contents)
+{
+    std::vector<std::byte> bytes{build(contents)};
+    std::ofstream file{path, std::ios::binary | std::ios::trunc};
+    file.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    if (!file)
+        throw SerializationError();
+}
+
+CacheSnapshot::CacheSnapshot(std::vector<std::byte> bytes) : buffer{std::move(bytes)}
+{
+    data = buffer.data();
+    size = buffer.size();
+    validate();
+}
+
+CacheSnapshot::CacheSnapshot(const std::string &path)
+{
+#if defined(SERIALIZE_MMAP)
+    int fd{::open(path.c_str(), O_RDONLY)};
+    if (fd < 0)
+        throw SerializationError();
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        throw SerializationError();
+    }
+    void *p{::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0)};
+    ::close(fd);
+    if (p == MAP_FAILED)
+        throw SerializationError();
+    data = static_cast<const std::byte *>(p);
+    size = st.st_size;
+    mapped = true;
+    try
+    {
+        validate();
+    }
+    catch (...)
+    {
+        ::munmap(p, size);
+        throw;
+    }
+#else
+    std::ifstream file{path, std::ios::binary};
+    if (!file)
+        throw SerializationError();
+    buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    data = buffer.data();
+    size = buffer.size();
+    validate();
+#endif
+}
+
+CacheSnapshot::~CacheSnapshot()
+{
+#if defined(SERIALIZE_MMAP)
+    if (mapped)
+        ::munmap(const_cast<std::byte *>(data), size);
+#endif
+}
+
+// Rejects files from another byte order or version, any entry that points
+// outside its section and entries out of (hash, key) order, so find can
+// trust the offsets and its binary search. Values are
+// not decoded here, which would make opening O(entries) on every worker;
+// find decodes the one it returns. Offsets are compared without adding to
+// them, which could wrap.
+void CacheSnapshot::validate()
+{
+    if (size < sizeof(Header))
+        throw SerializationError();
+    const Header &h{header()};
+    if (std::memcmp(h.magic, SNAPSHOTMAGIC, sizeof(h.magic)) != 0 || h.byteorder != SNAPSHOTBYTEORDER || h.version != SNAPSHOTVERSION)
+        throw SerializationError();
+    if (h.size != size || h.count > (size - sizeof(Header)) / sizeof(Entry))
+        throw SerializationError();
+    if (h.keys != sizeof(Header) + h.count * sizeof(Entry) || h.values < h.keys || h.values > size)
+        throw SerializationError();
+    uint64_t previoushash{0};
+    std::string_view previouskey{};
+    for (size_t i = 0; i < h.count; i++)
+    {
+        const Entry &e{entries()[i]};
+        if (e.key < h.keys || e.key > h.values || e.keylength > h.values - e.key)
+            throw SerializationError();
+        if (e.value < h.values || e.value > size || e.valuelength > size - e.value)
+            throw SerializationError();
+        std::string_view key{reinterpret_cast<const char *>(data + e.key), e.keylength};
+        if (i > 0 && (e.hash < previoushash || (e.hash == previoushash && key <= previouskey)))
+            throw SerializationError();
+        previoushash = e.hash;
+        previouskey = key;
+    }
+}
+
+// A value that does not decode exactly is treated as a miss, so find never
+// throws.
+std::optional<Factors> CacheSnapshot::find(std::string_view units) const
+{
+    if (data == nullptr)
+        return std::nullopt;
+    uint64_t hash{snapshot_hash(units)};
+    const Entry *begin{entries()};
+    const Entry *end{begin + header().count};
+    const Entry *it{std::lower_bound(begin, end, hash, [](const Entry &e, uint64_t h)
+                                     { return e.hash < h; })};
+    for (; it != end && it->hash == hash; ++it)
+    {
+        std::string_view key{reinterpret_cast<const char *>(data + it->key), it->keylength};
+        if (key != units)
+            continue;
+        size_t pos{0};
+        try
+        {
+            Factors f{decode_factors(std::span<const std::byte>(data + it->value, it->valuelength), pos)};
+            if (pos == it->valuelength)
+                return f;
+        }
+        catch (const SerializationError &)
+        {
+        }
+        catch (const FactorsError &)
+        {
+        }
+        return std::nullopt;
+    }
+    return std::nullopt;
+}
@@ -0,0 +1,73 @@
+#ifndef SERIALIZE_H
+#define SERIALIZE_H
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "parser.h"
+
+class SerializationError
+{
+public:
+    SerializationError() = default;
+};
+
+// Factors encoding: for each of multiplier, offset, m, kg, s, A, K, mol, cd
+// a LEB128 varint (byte length << 1 | sign) and the numerator magnitude in
+// little-endian bytes, then a varint byte length and the denominator bytes;
+// then a varint multiplier degree and, for a degree above 1, the radicand.
+void encode_factors(const Factors &, std::string &);
+Factors decode_factors(std::span<const std::byte>, size_t &);
+
+// A read-only expression-to-Factors table in one file, laid out so it can
+// be memory-mapped and shared by every process on a node:
+//   header | entries sorted by (hash, key) | keys | encoded Factors
+// Lookups binary-search the entries and decode only the matching value.
+// Only expressions over builtin units are stored, so a snapshot means the
+// same to a Parser whatever its registry holds.
+class CacheSnapshot
+{
+private:
+    struct Header
+    {
+        char magic[8];
+        uint32_t byteorder;
+        uint32_t version;
+        uint64_t count;
+        uint64_t keys;
+        uint64_t values;
+        uint64_t size;
+    };
+    struct Entry
+    {
+        uint64_t hash;
+        uint64_t key;
+        uint64_t value;
+        uint32_t keylength;
+        uint32_t valuelength;
+    };
+    const std::byte *data{nullptr};
+    size_t size{0};
+    bool mapped{false};
+    std::vector<std::byte> buffer{};
+    const Header &header() const { return *reinterpret_cast<const Header *>(data); }
+    const Entry *entries() const { return reinterpret_cast<const Entry *>(data + sizeof(Header)); }
+    void validate();
+
+public:
+    CacheSnapshot() = default;
+    explicit CacheSnapshot(const std::string &path);
+    explicit CacheSnapshot(std::vector<std::byte>);
+    CacheSnapshot(const CacheSnapshot &) = delete;
+    CacheSnapshot &operator=(const CacheSnapshot &) = delete;
+    ~CacheSnapshot();
+    size_t get_count() const { return data == nullptr ? 0 : header().count; }
+    std::optional<Factors> find(std::string_view) const;
+    static std::vector<std::byte> build(std::span<const std::pair<string, Factors>>);
+    static void write(const std::string &path, std::span<const std::pair<string, Factors>>);
+};
+#endif // SERIALIZE_H
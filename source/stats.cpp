@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <bit>
+#include "stats.h"
+
+#if defined(NUBIVIS_STATS)
+std::array<StatsCounters, STATSSHARDS> statsshards{};
+std::atomic<size_t> nextshard{0};
+
+void record_depth(uint64_t depth)
+{
+    std::atomic<uint64_t> &max_depth{local_stats().max_depth};
+    uint64_t seen{max_depth.load(std::memory_order_relaxed)};
+    while (depth > seen && !max_depth.compare_exchange_weak(seen, depth, std::memory_order_relaxed))
+        ;
+}
+
+LatencyTimer::~LatencyTimer()
+{
+    auto ns{std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()};
+    size_t bucket{ns > 0 ? static_cast<size_t>(std::bit_width(static_cast<uint64_t>(ns)) - 1) : 0};
+    local_stats().latency[std::min(bucket, LATENCYBUCKETS - 1)].fetch_add(1, std::memory_order_relaxed);
+    NUBIVIS_COUNT(parses);
+}
+
+ParseStats get_parse_stats()
+{
+    ParseStats s{};
+    for (const StatsCounters &c : statsshards)
+    {
+        s.parses += c.parses.load(std::memory_order_relaxed);
+        s.tokens += c.tokens.load(std::memory_order_relaxed);
+        s.unit_lookups += c.unit_lookups.load(std::memory_order_relaxed);
+        s.ambiguous_matches += c.ambiguous_matches.load(std::memory_order_relaxed);
+        s.prefix_fallbacks += c.prefix_fallbacks.load(std::memory_order_relaxed);
+        s.max_depth = std::max(s.max_depth, c.max_depth.load(std::memory_order_relaxed));
+        s.arena_allocations += c.arena_allocations.load(std::memory_order_relaxed);
+        s.heap_allocations += c.heap_allocations.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < LATENCYBUCKETS; i++)
+            s.latency[i] += c.latency[i].load(std::memory_order_relaxed);
+    }
+    return s;
+}
+
+void reset_parse_stats()
+{
+    for (StatsCounters &c : statsshards)
+    {
+        c.parses = 0;
+        c.tokens = 0;
+        c.unit_lookups = 0;
+        c.ambiguous_matches = 0;
+        c.prefix_fallbacks = 0;
+        c.max_depth = 0;
+        c.arena_allocations = 0;
+        c.heap_allocations = 0;
+        for (auto &bucket : c.latency)
+            bucket = 0;
+    }
+}
+#else
+ParseStats get_parse_stats()
+{
+    return ParseStats{};
+}
+
+void reset_parse_stats()
+{
+}
+#endif
@@ -0,0 +1,83 @@
+#ifndef STATS_H
+#define STATS_H
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Parser instrumentation, compiled in only with -DNUBIVIS_STATS. Without it
+// the NUBIVIS_ macros expand to nothing and get_parse_stats returns zeros.
+
+const size_t LATENCYBUCKETS{32};
+
+class ParseStats
+{
+public:
+    uint64_t parses{0};
+    uint64_t tokens{0};
+    uint64_t unit_lookups{0};
+    uint64_t ambiguous_matches{0};
+    uint64_t prefix_fallbacks{0};
+    uint64_t max_depth{0};
+    uint64_t arena_allocations{0};
+    uint64_t heap_allocations{0};
+    // latency[i] counts parses that took [2**i, 2**(i+1)) ns.
+    std::array<uint64_t, LATENCYBUCKETS> latency{};
+};
+
+ParseStats get_parse_stats();
+void reset_parse_stats();
+
+#if defined(NUBIVIS_STATS)
+// Each thread counts into one of STATSSHARDS shards, each on its own cache
+// lines, so that threads parsing at once do not contend for the counters
+// they are measuring. get_parse_stats sums the shards.
+const size_t STATSSHARDS{16};
+
+class alignas(64) StatsCounters
+{
+public:
+    std::atomic<uint64_t> parses{0};
+    std::atomic<uint64_t> tokens{0};
+    std::atomic<uint64_t> unit_lookups{0};
+    std::atomic<uint64_t> ambiguous_matches{0};
+    std::atomic<uint64_t> prefix_fallbacks{0};
+    std::atomic<uint64_t> max_depth{0};
+    std::atomic<uint64_t> arena_allocations{0};
+    std::atomic<uint64_t> heap_allocations{0};
+    std::array<std::atomic<uint64_t>, LATENCYBUCKETS> latency{};
+};
+
+extern std::array<StatsCounters, STATSSHARDS> statsshards;
+extern std::atomic<size_t> nextshard;
+
+inline StatsCounters &local_stats()
+{
+    thread_local StatsCounters &shard{statsshards[nextshard.fetch_add(1, std::memory_order_relaxed) % STATSSHARDS]};
+    return shard;
+}
+
+void record_depth(uint64_t);
+
+class LatencyTimer
+{
+private:
+    std::chrono::steady_clock::time_point start{std::chrono::steady_clock::now()};
+
+public:
+    LatencyTimer() = default;
+    LatencyTimer(const LatencyTimer &) = delete;
+    LatencyTimer &operator=(const LatencyTimer &) = delete;
+    ~LatencyTimer();
+};
+
+#define NUBIVIS_COUNT(counter) local_stats().counter.fetch_add(1, std::memory_order_relaxed)
+#define NUBIVIS_DEPTH(depth) record_depth(depth)
+#define NUBIVIS_TIME() LatencyTimer latencytimer {}
+#else
+#define NUBIVIS_COUNT(counter)
+#define NUBIVIS_DEPTH(depth)
+#define NUBIVIS_TIME()
+#endif
+#endif // STATS_H
@@ -0,0 +1,318 @@
+#ifndef TABLES_H
+#define TABLES_H
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+class Scalar
+{
+public:
+    int64_t num{0};
+    int64_t den{0};
+    double value{0};
+
+    constexpr Scalar(int n) : num{n}, den{1}, value(n) {}
+    constexpr Scalar(int64_t n, int64_t d = 1) : num{n}, den{d}, value{static_cast<double>(n) / static_cast<double>(d)} {}
+    constexpr Scalar(double v) : value{v} {}
+    constexpr bool exact() const { return den != 0; }
+};
+
+class Unit
+{
+public:
+    std::string_view name;
+    Scalar multiplier;
+    Scalar offset;
+    int8_t m;
+    int8_t kg;
+    int8_t s;
+    int8_t A;
+    int8_t K;
+    int8_t mol;
+    int8_t cd;
+
+    constexpr Unit(std::string_view name, Scalar multiplier, Scalar offset, int8_t m, int8_t kg, int8_t s, int8_t A, int8_t K, int8_t mol, int8_t cd)
+        : name{name}, multiplier{multiplier}, offset{offset}, m{m}, kg{kg}, s{s}, A{A}, K{K}, mol{mol}, cd{cd} {}
+};
+
+class Prefix
+{
+public:
+    std::string_view name;
+    Scalar multiplier;
+
+    constexpr Prefix(std::string_view name, Scalar multiplier) : name{name}, multiplier{multiplier} {}
+};
+
+// Open-addressed table whose hash seed is searched at compile time until
+// every name lands in its own slot, so a lookup is one hash and one compare.
+template <typename Entry, size_t N, size_t BITS>
+class LookupTable
+{
+private:
+    static constexpr size_t SIZE{size_t{1} << BITS};
+    std::array<Entry, N> entries;
+    std::array<int16_t, SIZE> slots{};
+    uint32_t seed{0};
+
+    static constexpr size_t slot(uint32_t seed, std::string_view name)
+    {
+        uint32_t h{2166136261u ^ seed};
+        for (char ch : name)
+            h = (h ^ static_cast<unsigned char>(ch)) * 16777619u;
+        return (h * 2654435769u) >> (32 - BITS);
+    }
+
+    constexpr bool place(uint32_t candidate)
+    {
+        slots.fill(-1);
+        for (size_t i = 0; i < N; i++)
+        {
+            size_t k{slot(candidate, entries[i].name)};
+            if (slots[k] != -1)
+                return false;
+            slots[k] = static_cast<int16_t>(i);
+        }
+        seed = candidate;
+        return true;
+    }
+
+public:
+    constexpr LookupTable(const std::array<Entry, N> &entries) : entries{entries}
+    {
+        static_assert(N < SIZE);
+        uint32_t candidate{0};
+        while (!place(candidate))
+            candidate++;
+    }
+    constexpr const Entry *find(std::string_view name) const
+    {
+        int16_t i{slots[slot(seed, name)]};
+        if (i == -1 || entries[i].name != name)
+            return nullptr;
+        return &entries[i];
+    }
+    constexpr const Entry *begin() const { return entries.data(); }
+    constexpr const Entry *end() const { return entries.data() + N; }
+    constexpr size_t size() const { return N; }
+};
+
+template <typename Entry, size_t N>
+constexpr auto make_table(const Entry (&entries)[N])
+{
+    std::array<Entry, N> a{std::to_array(entries)};
+    return LookupTable<Entry, N, (N < 16 ? 6 : N < 32 ? 7 : 8)>(a);
+}
+
+// A dimension signature packs the seven base exponents (m, kg, s, A, K,
+// mol, cd) into 9-bit two's complement fields holding twelfths, so equal
+// dimensions compare and hash as one integer. Exponents outside that grid
+// set only the top bit, and callers compare them exactly instead.
+constexpr int32_t SIGNATURESCALE{12};
+constexpr int32_t SIGNATUREMIN{-256};
+constexpr int32_t SIGNATUREMAX{255};
+constexpr uint64_t SIGNATUREINEXACT{uint64_t{1} << 63};
+
+constexpr uint64_t pack_signature(const std::array<int32_t, 7> &twelfths)
+{
+    uint64_t signature{0};
+    for (size_t i = 0; i < 7; i++)
+        signature |= (static_cast<uint64_t>(twelfths[i]) & 0x1ff) << (9 * i);
+    return signature;
+}
+
+constexpr uint64_t unit_signature(const Unit &u)
+{
+    return pack_signature({u.m * SIGNATURESCALE,
+                           u.kg * SIGNATURESCALE,
+                           u.s * SIGNATURESCALE,
+                           u.A * SIGNATURESCALE,
+                           u.K * SIGNATURESCALE,
+                           u.mol * SIGNATURESCALE,
+                           u.cd * SIGNATURESCALE});
+}
+
+inline constexpr Unit SIUNITS_ENTRIES[]{
+    {"m", 1, 0, 1, 0, 0, 0, 0, 0, 0},
+    {"kg", 1, 0, 0, 1, 0, 0, 0, 0, 0},
+    {"g", Scalar(1, 1000), 0, 0, 1, 0, 0, 0, 0, 0},
+    {"s", 1, 0, 0, 0, 1, 0, 0, 0, 0},
+    {"A", 1, 0, 0, 0, 0, 1, 0, 0, 0},
+    {"K", 1, 0, 0, 0, 0, 0, 1, 0, 0},
+    {"mol", 1, 0, 0, 0, 0, 0, 0, 1, 0},
+    {"cd", 1, 0, 0, 0, 0, 0, 0, 0, 1},
+    {"rad", 1, 0, 0, 0, 0, 0, 0, 0, 0},
+    {"sr", 1, 0, 0, 0, 0, 0, 0, 0, 0},
+    {"Hz", 1, 0, 0, 0, -1, 0, 0, 0, 0},
+    {"N", 1, 0, 1, 1, -2, 0, 0, 0, 0},
+    {"Pa", 1, 0, -1, 1, -2, 0, 0, 0, 0},
+    {"J", 1, 0, 2, 1, -2, 0, 0, 0, 0},
+    {"W", 1, 0, 2, 1, -3, 0, 0, 0, 0},
+    {"C", 1, 0, 0, 0, 1, 1, 0, 0, 0},
+    {"V", 1, 0, 2, 1, -3, -1, 0, 0, 0},
+    {"F", 1, 0, -2, -1, 4, 2, 0, 0, 0},
+    {"Ω", 1, 0, 2, 1, -3, -2, 0, 0, 0},
+    {"S", 1, 0, -2, -1, -2, -1, 0, 0, 0},
+    {"Wb", 1, 0, 2, 1, -2, -1, 0, 0, 0},
+    {"T", 1, 0, 0, 1, -2, -1, 0, 0, 0},
+    {"H", 1, 0, 2, 1, -2, -2, 0, 0, 0},
+    {"degC", 1, Scalar(27315, 100), 0, 0, 0, 0, 1, 0, 0},
+    {"lm", 1, 0, 0, 0, 0, 0, 0, 0, 1},
+    {"lx", 1, 0, -2, 0, 0, 0, 0, 0, 1},
+    {"Bq", 1, 0, 0, 0, -1, 0, 0, 0, 0},
+    {"Gy", 1, 0, 2, 0, -2, 0, 0, 0, 0},
+    {"Sv", 1, 0, 2, 0, -2, 0, 0, 0, 0},
+    {"kat", 1, 0, 0, 0, -1, 0, 0, 1, 0},
+    {"L", Scalar(1, 1000), 0, 3, 0, 0, 0, 0, 0, 0},
+};
+
+inline constexpr Unit NONSIUNITS_ENTRIES[]{
+    {"Å", Scalar(1, 10000000000), 0, 1, 0, 0, 0, 0, 0, 0},
+    {"ua", 1.495979e11, 0, 1, 0, 0, 0, 0, 0, 0},
+    {"ch", 2.011684e1, 0, 1, 0, 0, 0, 0, 0, 0},
+    {"fathom", 1.828804, 0, 1, 0, 0, 0, 0, 0, 0},
+    {"fermi", Scalar(1, 1000000000000000), 0, 1, 0, 0, 0, 0, 0, 0},
+    {"ft", 3.048e-1, 0, 1, 0, 0, 0, 0, 0, 0},
+    {"in", 2.54e-2, 0, 1, 0, 0, 0, 0, 0, 0},
+    {"µ", Scalar(1, 1000000), 0, 1, 0, 0, 0, 0, 0, 0},
+    {"mil", Scalar(254, 10000000), 0, 1, 0, 0, 0, 0, 0, 0},
+    {"mi", 1.609344e3, 0, 1, 0, 0, 0, 0, 0, 0},
+    {"yd", 9.144e-1, 0, 1, 0, 0, 0, 0, 0, 0},
+    {"oz", 2.834952e-2, 0, 0, 1, 0, 0, 0, 0, 0},
+    {"lb", 4.535924e-1, 0, 0, 1, 0, 0, 0, 0, 0},
+    {"d", 8.64e4, 0, 0, 0, 1, 0, 0, 0, 0},
+    {"h", 3.6e3, 0, 0, 0, 1, 0, 0, 0, 0},
+    {"min", 60, 0, 0, 0, 1, 0, 0, 0, 0},
+    {"degF", Scalar(10, 18), 459.67, 0, 0, 0, 0, 1, 0, 0},
+    {"degR", Scalar(10, 18), 0, 0, 0, 0, 0, 1, 0, 0},
+    {"BTU", 1.05587e3, 0, 2, 1, -2, 0, 0, 0, 0},
+    {"cal", 4.19002, 0, 2, 1, -2, 0, 0, 0, 0},
+    {"eV", 1.602176e-19, 0, 2, 1, -2, 0, 0, 0, 0},
+    {"lbf", 4.448222, 0, 1, 1, -2, 0, 0, 0, 0},
+    {"horsepower", 7.46e2, 0, 2, 1, -3, 0, 0, 0, 0},
+    {"atm", 1.01325e5, 0, -1, 1, -2, 0, 0, 0, 0},
+    {"bar", Scalar(100000, 1), 0, -1, 1, -2, 0, 0, 0, 0},
+    {"inHg", 3.386389e3, 0, -1, 1, -2, 0, 0, 0, 0},
+    {"psi", 6.894757, 0, -1, 1, -2, 0, 0, 0, 0},
+    {"torr", 1.333224e2, 0, -1, 1, -2, 0, 0, 0, 0},
+    {"rad", 1e-2, 0, 2, 0, -2, 0, 0, 0, 0},
+    {"rem", 1e-2, 0, 2, 0, -2, 0, 0, 0, 0},
+    {"gal", 3.785412e-3, 0, 3, 0, 0, 0, 0, 0, 0},
+};
+
+inline constexpr Prefix PREFIXES_ENTRIES[]{
+    {"P", Scalar(1000000000000000)},
+    {"T", Scalar(1000000000000)},
+    {"G", Scalar(1000000000)},
+    {"M", Scalar(1000000)},
+    {"k", Scalar(1000)},
+    {"h", Scalar(100)},
+    {"da", Scalar(10)},
+    {"d", Scalar(1, 10)},
+    {"c", Scalar(1, 100)},
+    {"m", Scalar(1, 1000)},
+    {"µ", Scalar(1, 1000000)},
+    {"n", Scalar(1, 1000000000)},
+    {"p", Scalar(1, 1000000000000)},
+    {"f", Scalar(1, 1000000000000000)},
+};
+
+enum CharClass : uint8_t
+{
+    CHAR_OTHER,
+    CHAR_DIGIT,
+    CHAR_LETTER,
+    CHAR_OPERATOR,
+    CHAR_STAR,
+    CHAR_LEAD,
+};
+
+inline constexpr std::string_view ASCII_LETTERS{"aABbcCdeEfFgGhHiJkKlLmMnNopPqrRSstTuUvVwWxyYzZ"};
+inline constexpr std::string_view MULTIBYTE_LETTERS[]{"µ", "Ω", "Å"};
+
+constexpr std::array<CharClass, 256> make_char_classes()
+{
+    std::array<CharClass, 256> classes{};
+    for (char ch = '0'; ch <= '9'; ch++)
+        classes[static_cast<unsigned char>(ch)] = CHAR_DIGIT;
+    for (char ch : ASCII_LETTERS)
+        classes[static_cast<unsigned char>(ch)] = CHAR_LETTER;
+    for (char ch : std::string_view{"-+/()"})
+        classes[static_cast<unsigned char>(ch)] = CHAR_OPERATOR;
+    classes['*'] = CHAR_STAR;
+    for (std::string_view letter : MULTIBYTE_LETTERS)
+        classes[static_cast<unsigned char>(letter[0])] = CHAR_LEAD;
+    return classes;
+}
+
+inline constexpr std::array<CharClass, 256> CHAR_CLASSES{make_char_classes()};
+
+constexpr CharClass char_class(char ch)
+{
+    return CHAR_CLASSES[static_cast<unsigned char>(ch)];
+}
+
+// Byte length of the letter starting at position, or 0 if there is none.
+constexpr size_t letter_length(std::string_view expression, size_t position)
+{
+    CharClass c{char_class(expression[position])};
+    if (c == CHAR_LETTER)
+        return 1;
+    if (c != CHAR_LEAD)
+        return 0;
+    for (std::string_view letter : MULTIBYTE_LETTERS)
+        if (expression.substr(position, letter.size()) == letter)
+            return letter.size();
+    return 0;
+}
+
+inline constexpr auto SIUNITS{make_table(SIUNITS_ENTRIES)};
+inline constexpr auto NONSIUNITS{make_table(NONSIUNITS_ENTRIES)};
+inline constexpr auto PREFIXES{make_table(PREFIXES_ENTRIES)};
+// The builtin readings of a token: unit is an exact NONSIUNITS or SIUNITS
+// name, prefix + base a prefixed SI unit. A token with more than one reading
+// is ambiguous and resolves deterministically: exact names first,
+// NONSIUNITS before SIUNITS, then the prefixed reading with the longest
+// prefix.
+class UnitMatch
+{
+public:
+    const Unit *unit{nullptr};
+    const Prefix *prefix{nullptr};
+    const Unit *base{nullptr};
+    uint8_t readings{0};
+    constexpr bool ambiguous() const { return readings > 1; }
+};
+
+// Resolves a token against the tables directly. UnitTrie precomputes this
+// for every name so the run time parse is a single walk; the compile time
+// parse calls it as is.
+constexpr UnitMatch match_unit(std::string_view token)
+{
+    UnitMatch m{};
+    if (const Unit *u{NONSIUNITS.find(token)})
+    {
+        m.unit = u;
+        m.readings++;
+    }
+    if (const Unit *u{SIUNITS.find(token)})
+    {
+        if (m.unit == nullptr)
+            m.unit = u;
+        m.readings++;
+    }
+    for (const Prefix &p : PREFIXES)
+        if (token.size() > p.name.size() && token.starts_with(p.name))
+            if (const Unit *u{SIUNITS.find(token.substr(p.name.size()))})
+            {
+                if (m.prefix == nullptr || p.name.size() > m.prefix->name.size())
+                {
+                    m.prefix = &p;
+                    m.base = u;
+                }
+                m.readings++;
+            }
+    return m;
+}
+#endif // TABLES_H
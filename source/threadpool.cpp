@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <exception>
+#include "threadpool.h"
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+thread_local size_t workerindex{SIZE_MAX};
+
+ThreadPool::ThreadPool(size_t nthreads, bool pinned)
+{
+    nthreads = std::max<size_t>(nthreads, 1);
+    for (size_t i = 0; i < nthreads; i++)
+        queues.push_back(std::make_unique<Queue>());
+    for (size_t i = 0; i < nthreads; i++)
+    {
+        workers.emplace_back(&ThreadPool::work, this, i);
+#if defined(__linux__)
+        if (pinned)
+        {
+            cpu_set_t cpus{};
+            CPU_ZERO(&cpus);
+            CPU_SET(i % std::max<size_t>(std::thread::hardware_concurrency(), 1), &cpus);
+            pthread_setaffinity_np(workers.back().native_handle(), sizeof(cpus), &cpus);
+        }
+#endif
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+    }
+    ready.notify_all();
+    for (auto &w : workers)
+        w.join();
+}
+
+// Own queue from the front, then the others from the back.
+bool ThreadPool::pop(size_t index, std::function<void()> &task)
+{
+    for (size_t k = 0; k < queues.size(); k++)
+    {
+        Queue &q{*queues[(index + k) % queues.size()]};
+        std::lock_guard<std::mutex> lock{q.mutex};
+        if (q.tasks.empty())
+            continue;
+        if (k == 0)
+        {
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+        }
+        else
+        {
+            task = std::move(q.tasks.back());
+            q.tasks.pop_back();
+        }
+        pending--;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::push(size_t index, std::function<void()> task)
+{
+    // Count the task before it becomes visible so a pop cannot take
+    // pending below zero.
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        pending++;
+    }
+    {
+        Queue &q{*queues[index % queues.size()]};
+        std::lock_guard<std::mutex> lock{q.mutex};
+        q.tasks.push_back(std::move(task));
+    }
+    ready.notify_one();
+}
+
+void ThreadPool::work(size_t index)
+{
+    workerindex = index;
+    while (true)
+    {
+        std::function<void()> task{};
+        if (pop(index, task))
+        {
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock{mutex};
+        ready.wait(lock, [this]
+                   { return stopping || pending > 0; });
+        if (stopping && pending == 0)
+            return;
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    if (workerindex < queues.size())
+        push(workerindex, std::move(task));
+    else
+        push(nextqueue++, std::move(task));
+}
+
+void ThreadPool::submit(size_t worker, std::function<void()> task)
+{
+    push(worker, std::move(task));
+}
+
+// Participant j owns a contiguous range of indices and, once it is
+// exhausted, steals indices from the ranges of the others. Helper j is
+// queued on worker j - 1, but may be stolen and run anywhere. A caller that
+// is itself a worker runs queued tasks while it waits, so nested calls
+// cannot leave every worker blocked on helpers that none of them will run.
+void ThreadPool::parallel_for(size_t n, const std::function<void(size_t)> &f)
+{
+    struct Range
+    {
+        std::atomic<size_t> next{0};
+        size_t end{0};
+    };
+    size_t helpers{n == 0 ? 0 : std::min(n - 1, workers.size())};
+    size_t participants{helpers + 1};
+    std::vector<Range> ranges(participants);
+    for (size_t j = 0; j < participants; j++)
+    {
+        ranges[j].next = n * j / participants;
+        ranges[j].end = n * (j + 1) / participants;
+    }
+    std::mutex done_mutex{};
+    std::condition_variable done{};
+    size_t running{helpers};
+    std::exception_ptr error{};
+    auto run = [&](size_t j)
+    {
+        try
+        {
+            for (size_t k = 0; k < participants; k++)
+            {
+                Range &r{ranges[(j + k) % participants]};
+                for (size_t i = r.next++; i < r.end; i = r.next++)
+                    f(i);
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock{done_mutex};
+            if (!error)
+                error = std::current_exception();
+            for (Range &r : ranges)
+                r.next = r.end;
+        }
+    };
+    for (size_t i = 0; i < helpers; i++)
+        push(i, [&, i]
+             {
+                 run(i + 1);
+                 std::lock_guard<std::mutex> lock{done_mutex};
+                 if (--running == 0)
+                     done.notify_one(); });
+    run(0);
+    if (workerindex < queues.size())
+    {
+        std::function<void()> task{};
+        while (true)
+        {
+            {
+                std::lock_guard<std::mutex> lock{done_mutex};
+                if (running == 0)
+                    break;
+            }
+            if (!pop(workerindex, task))
+                break;
+            task();
+            task = nullptr;
+        }
+    }
+    std::unique_lock<std::mutex> lock{done_mutex};
+    done.wait(lock, [&]
+              { return running == 0; });
+    if (error)
+        std::rethrow_exception(error);
+}
+
+Executor ThreadPool::executor()
+{
+    return [this](size_t n, const std::function<void(size_t)> &f)
+    { parallel_for(n, f); };
+}
+
+ThreadPool &ThreadPool::shared()
+{
+    static ThreadPool pool{};
+    return pool;
+}
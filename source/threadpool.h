@@ -0,0 +1,50 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs n indexed tasks and returns once all have finished.
+typedef std::function<void(size_t, const std::function<void(size_t)> &)> Executor;
+
+// Each worker owns a task deque and steals from the others when it runs
+// dry. With pinning, worker i is bound to CPU i modulo the CPU count; no
+// attention is paid to NUMA topology.
+class ThreadPool
+{
+private:
+    struct Queue
+    {
+        std::mutex mutex{};
+        std::deque<std::function<void()>> tasks{};
+    };
+    std::vector<std::thread> workers{};
+    std::vector<std::unique_ptr<Queue>> queues{};
+    std::mutex mutex{};
+    std::condition_variable ready{};
+    std::atomic<size_t> pending{0};
+    std::atomic<size_t> nextqueue{0};
+    bool stopping{false};
+    void work(size_t);
+    bool pop(size_t, std::function<void()> &);
+    void push(size_t, std::function<void()>);
+
+public:
+    ThreadPool(size_t nthreads = std::thread::hardware_concurrency(), bool pinned = false);
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ~ThreadPool();
+    size_t size() const { return workers.size(); }
+    void submit(std::function<void()>);
+    void submit(size_t worker, std::function<void()>);
+    void parallel_for(size_t, const std::function<void(size_t)> &);
+    Executor executor();
+    static ThreadPool &shared();
+};
+#endif // THREADPOOL_H
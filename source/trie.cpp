@@ -0,0 +1,72 @@
+#include <algorithm>
+#include "trie.h"
+
+// Child index 0 is the root, which is never a child, so it marks a missing
+// edge; alphabet index 0 likewise marks a byte that no name contains.
+UnitTrie::UnitTrie()
+{
+    auto letters = [this](std::string_view name)
+    {
+        for (char ch : name)
+            if (alphabet[static_cast<unsigned char>(ch)] == 0)
+                alphabet[static_cast<unsigned char>(ch)] = static_cast<uint8_t>(width++);
+    };
+    for (const Unit &u : NONSIUNITS)
+        letters(u.name);
+    for (const Unit &u : SIUNITS)
+        letters(u.name);
+    for (const Prefix &p : PREFIXES)
+        letters(p.name);
+    children.assign(width, 0);
+    matches.emplace_back();
+    auto add = [this](std::string_view name) { matches[insert(name)] = match_unit(name); };
+    for (const Unit &u : NONSIUNITS)
+        add(u.name);
+    for (const Unit &u : SIUNITS)
+        add(u.name);
+    for (const Prefix &p : PREFIXES)
+        for (const Unit &u : SIUNITS)
+            add(std::string(p.name) + std::string(u.name));
+    for (size_t node = 0; node < matches.size(); node++)
+        if (matches[node].ambiguous())
+        {
+            const UnitMatch &m{matches[node]};
+            ambiguities.push_back(m.unit != nullptr ? std::string(m.unit->name) : std::string(m.prefix->name) + std::string(m.base->name));
+        }
+    std::sort(ambiguities.begin(), ambiguities.end());
+}
+
+size_t UnitTrie::insert(std::string_view name)
+{
+    size_t node{0};
+    for (char ch : name)
+    {
+        size_t edge{node * width + alphabet[static_cast<unsigned char>(ch)]};
+        if (children[edge] == 0)
+        {
+            children[edge] = static_cast<uint16_t>(matches.size());
+            matches.emplace_back();
+            children.resize(children.size() + width, 0);
+        }
+        node = children[edge];
+    }
+    return node;
+}
+
+UnitMatch UnitTrie::find(std::string_view token) const
+{
+    size_t node{0};
+    for (char ch : token)
+    {
+        uint8_t letter{alphabet[static_cast<unsigned char>(ch)]};
+        if (letter == 0 || (node = children[node * width + letter]) == 0)
+            return UnitMatch{};
+    }
+    return matches[node];
+}
+
+const UnitTrie &UnitTrie::builtin()
+{
+    static const UnitTrie trie{};
+    return trie;
+}
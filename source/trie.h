@@ -0,0 +1,30 @@
+#ifndef TRIE_H
+#define TRIE_H
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "tables.h"
+
+// Trie over every builtin unit name and every prefix + SI unit name. Bytes
+// are mapped to a dense alphabet so that each node is a flat row of child
+// indices and a token resolves in a single pass over its bytes.
+class UnitTrie
+{
+private:
+    std::array<uint8_t, 256> alphabet{};
+    size_t width{1};
+    std::vector<uint16_t> children{};
+    std::vector<UnitMatch> matches{};
+    std::vector<std::string> ambiguities{};
+    size_t insert(std::string_view);
+
+public:
+    UnitTrie();
+    UnitMatch find(std::string_view) const;
+    const std::vector<std::string> &get_ambiguities() const { return ambiguities; }
+    size_t size() const { return matches.size(); }
+    static const UnitTrie &builtin();
+};
+#endif // TRIE_H
@@ -0,0 +1,34 @@
+#include "quantity.h"
+
+// Nothing here runs: the checks below compile the consteval parser, the
+// _units literal and Quantity with every build.
+static_assert(match_unit("kg").unit == SIUNITS.find("kg"));
+static_assert(match_unit("kg").ambiguous());
+static_assert(match_unit("rad").unit == NONSIUNITS.find("rad"));
+static_assert(match_unit("dam").prefix == PREFIXES.find("da"));
+static_assert(match_unit("Pa").unit == SIUNITS.find("Pa"));
+static_assert(match_unit("xyz").readings == 0);
+
+static_assert("N*m"_units == "kg*m**2/s**2"_units);
+static_assert("kg*m/s**2"_units == "N"_units);
+static_assert("km"_units.get_multiplier() == 1000);
+static_assert("daN"_units.get_multiplier() == 10);
+static_assert("m**(1/2)"_units.get_dimension().m == Exponent(1, 2));
+static_assert("degC"_units.get_offset() != 0);
+static_assert("degC*s"_units.get_offset() == "degC"_units.get_offset());
+
+static_assert(dimension("W*s") == dimension("N*m"));
+static_assert(dimension("Hz*s") == Dimension{});
+
+template <typename A, typename B>
+concept Addable = requires(A a, B b) { a + b; };
+
+typedef Quantity<double, dimension("m")> Length;
+typedef Quantity<double, dimension("s")> Duration;
+
+static_assert(Addable<Length, Length>);
+static_assert(!Addable<Length, Duration>);
+static_assert(std::is_same_v<decltype(Length{} / Duration{}), Quantity<double, dimension("m/s")>>);
+static_assert(std::is_same_v<decltype(Length{} * Length{} / Length{}), Length>);
+static_assert((Length(3) + Length(4)).get_value() == 7);
+static_assert(Length(2) < Length(3));
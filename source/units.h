@@ -0,0 +1,66 @@
+#ifndef UNITS_H
+#define UNITS_H
+#include <string_view>
+#include "fastfactors.h"
+#include "grammar.h"
+
+// The value the grammar accumulates in constant expressions: FastFactors,
+// with the multiplier also kept as an exact Exponent while the value is a
+// number that may become an exponent. An Exponent that overflows throws,
+// which at compile time is as ill-formed as any other failure.
+class ConstValue
+{
+private:
+    FastFactors factors{};
+    Exponent multiplier{1};
+
+    constexpr bool combine(const ConstValue &o, bool divide)
+    {
+        if (factors.get_offset() != 0 && o.factors.get_offset() != 0)
+            return false;
+        multiplier = divide ? multiplier / o.multiplier : multiplier * o.multiplier;
+        double x{divide ? factors.get_multiplier() / o.factors.get_multiplier() : factors.get_multiplier() * o.factors.get_multiplier()};
+        Dimension d{divide ? factors.get_dimension() / o.factors.get_dimension() : factors.get_dimension() * o.factors.get_dimension()};
+        factors = FastFactors(x, factors.get_offset(), d);
+        return true;
+    }
+
+public:
+    constexpr ConstValue() = default;
+    constexpr explicit ConstValue(const Unit &u) : factors{u} {}
+    constexpr ConstValue(const Unit &base, const Prefix &prefix)
+        : factors{FastFactors(base).get_multiplier() * prefix.multiplier.value, FastFactors(base).get_offset(), FastFactors(base).get_dimension()} {}
+    // Registered units are not visible in constant expressions.
+    bool try_assign(const Factors &) { return false; }
+    constexpr Exponent get_multiplier() const { return multiplier; }
+    constexpr void set_multiplier(Exponent e)
+    {
+        multiplier = e;
+        factors = FastFactors(static_cast<double>(e.numerator()) / e.denominator(), 0, Dimension{});
+    }
+    constexpr const FastFactors &get_factors() const { return factors; }
+    constexpr bool try_multiply(const ConstValue &o) { return combine(o, false); }
+    constexpr bool try_divide(const ConstValue &o) { return combine(o, true); }
+    constexpr bool try_pow(const ConstValue &e)
+    {
+        if (factors.get_offset() != 0 || factors.get_multiplier() < 0)
+            return false;
+        factors = factors.pow(e.multiplier);
+        return true;
+    }
+};
+
+// An invalid expression fails to compile.
+consteval FastFactors units(std::string_view expression)
+{
+    Grammar<ConstValue>::Result f{Grammar<ConstValue>::parse(expression, nullptr)};
+    if (!f)
+        throw TokenError();
+    return f->get_factors();
+}
+
+consteval FastFactors operator""_units(const char *expression, size_t n)
+{
+    return units(std::string_view(expression, n));
+}
+#endif // UNITS_H